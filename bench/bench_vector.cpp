@@ -34,6 +34,29 @@ static void BM_at_prefetch(benchmark::State &state) {
 }
 BENCHMARK(BM_at_prefetch)->Args({0});
 
+// Walk down every column of a row-major matrix whose rows span several
+// blocks, which is the access pattern of Matrix::dot
+template <pc2l::PrefetchStrategy Strategy>
+static void BM_column_walk(benchmark::State &state) {
+  const size_t cols = 64, rows = state.range(0);
+  pc2l::Vector<double, 8 * sizeof(double), 5, Strategy> m(rows * cols, 1.0);
+  while (state.KeepRunning()) {
+    double sum = 0;
+    for (size_t col = 0; col < cols; col++) {
+      for (size_t row = 0; row < rows; row++) {
+        sum += m.at(row * cols + col);
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+}
+BENCHMARK_TEMPLATE(BM_column_walk, pc2l::NONE)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000);
+BENCHMARK_TEMPLATE(BM_column_walk, pc2l::ADAPTIVE)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000);
+
 static void BM_insert(benchmark::State &state) {
   pc2l::Vector<int, 8 * sizeof(int)> v;
   // so now the last 3 blocks will be in cache (default LRU strategy)
@@ -45,6 +68,16 @@ static void BM_insert(benchmark::State &state) {
 }
 BENCHMARK(BM_insert)->Args({0});
 
+static void BM_append(benchmark::State &state) {
+  std::vector<int> values(state.range(0));
+  std::iota(values.begin(), values.end(), 0);
+  while (state.KeepRunning()) {
+    pc2l::Vector<int, 8 * sizeof(int)> v;
+    v.append(values.data(), values.size());
+  }
+}
+BENCHMARK(BM_append)->RangeMultiplier(10)->Range(10, 100000);
+
 static void BM_replace(benchmark::State &state) {
   pc2l::Vector<int, 8 * sizeof(int)> v;
   v.push_back(0);
@@ -89,6 +122,30 @@ static void BM_find_out_of_cache(benchmark::State &state) {
 }
 BENCHMARK(BM_find_out_of_cache)->RangeMultiplier(10)->Range(10, 10000000000);
 
+static void BM_find_pushdown(benchmark::State &state) {
+  pc2l::Vector<int, 8 * sizeof(int)> v;
+  for (int i = 0; i < state.range(0); i++) {
+    v.push_back(i);
+  }
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        pc2l::find(v.begin(), v.end(), int(state.range(0) / 2)));
+  }
+}
+BENCHMARK(BM_find_pushdown)->RangeMultiplier(10)->Range(10, 10000000);
+
+static void BM_read_out_of_cache(benchmark::State &state) {
+  pc2l::Vector<int, 8 * sizeof(int)> v;
+  for (int i = 0; i < state.range(0); i++) {
+    v.push_back(i);
+  }
+  std::vector<int> out(v.size());
+  while (state.KeepRunning()) {
+    v.read(0, v.size(), out.data());
+  }
+}
+BENCHMARK(BM_read_out_of_cache)->RangeMultiplier(10)->Range(10, 100000);
+
 static void BM_project_euler(benchmark::State &state) {
   pc2l::Vector<unsigned long long> vec(state.range(0));
 
@@ -107,6 +164,32 @@ static void BM_project_euler(benchmark::State &state) {
 }
 BENCHMARK(BM_project_euler)->RangeMultiplier(10)->Range(10, 10000000000);
 
+static void BM_project_euler_segmented(benchmark::State &state) {
+  pc2l::Vector<unsigned long long> vec(state.range(0));
+
+  while (state.KeepRunning()) {
+    // fill vector with values from 1 to n
+    unsigned long long next = 1;
+    pc2l::for_each_segment(vec.begin(), vec.end(),
+                           [&next](auto *values, size_t count) {
+                             std::iota(values, values + count, next);
+                             next += count;
+                           });
+
+    // every number that does not have a 3 or 5 as a factor is set to 0
+    pc2l::transform(vec.begin(), vec.end(), vec.begin(), [](auto i) {
+      return !((i % 3) || (i % 5)) ? 0 : i;
+    });
+
+    // sum all elements in the vector
+    auto total = pc2l::accumulate(vec.begin(), vec.end(), 0ULL);
+    benchmark::DoNotOptimize(total);
+  }
+}
+BENCHMARK(BM_project_euler_segmented)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000000000);
+
 static void BM_std_sort(benchmark::State &state) {
   pc2l::Vector<unsigned long long> vec;
   for (auto i = 0; i < state.range(0); i++) {
@@ -118,6 +201,18 @@ static void BM_std_sort(benchmark::State &state) {
 }
 
 BENCHMARK(BM_std_sort)->RangeMultiplier(10)->Range(10, 10000000000);
+
+static void BM_pc2l_sort(benchmark::State &state) {
+  pc2l::Vector<unsigned long long> vec;
+  for (auto i = 0; i < state.range(0); i++) {
+    vec.push_back(state.range(0) - i);
+  }
+  while (state.KeepRunning()) {
+    pc2l::sort(vec);
+  }
+}
+
+BENCHMARK(BM_pc2l_sort)->RangeMultiplier(10)->Range(10, 10000000000);
 static void BM_find_in_cache(benchmark::State &state) {
   pc2l::Vector<int, 8 * sizeof(int)> v;
   for (int i = 0; i < 100; i++) {
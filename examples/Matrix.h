@@ -14,8 +14,9 @@
 using Val = double;
 
 /** Short cut to a 2-d vector double values to streamline the code */
-// block size is 100 doubles
-using Vec = pc2l::Vector<Val, 100 * sizeof(double)>;
+// block size is 100 doubles, and walks down a column are prefetched along
+// their stride
+using Vec = pc2l::Vector<Val, 100 * sizeof(double), 5, pc2l::ADAPTIVE>;
 
 /** A matrix class to perform basic matrix operations.
 
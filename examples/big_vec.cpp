@@ -55,14 +55,20 @@ int main(int argc, char *argv[]) {
   pc2l::Vector<ull> vec(num);
 
   // fill vector with values from 1 to n
-  std::iota(vec.begin(), vec.end(), 1);
+  pc2l::for_each_segment(vec.begin(), vec.end(),
+                         [next = 1ULL](ull *values, size_t count) mutable {
+                           std::iota(values, values + count, next);
+                           next += count;
+                         });
 
-  // every number that does not have a 3 or 5 as a factor is set to 0
-  std::replace_if(
-      vec.begin(), vec.end(), [](auto i) { return !((i % 3) || (i % 5)); }, 0);
+  // every number that does not have a 3 or 5 as a factor is set to 0. The
+  // vector is larger than the cache, so the workers that hold the blocks
+  // transform them in place
+  pc2l::transform(vec.begin(), vec.end(), vec.begin(),
+                  [](ull i) { return !((i % 3) || (i % 5)) ? 0 : i; });
 
   // sum all elements in the vector
-  auto total = std::accumulate(vec.begin(), vec.end(), 0ULL);
+  auto total = pc2l::accumulate(vec.begin(), vec.end(), 0ULL);
 
   std::cout << "The total is " << total << std::endl;
 
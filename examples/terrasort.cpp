@@ -64,7 +64,7 @@ int main(int argc, char *argv[]) {
               << ((clock() - start) * 1000) / CLOCKS_PER_SEC << "ms"
               << std::endl;
     auto sortStart = clock();
-    std::sort(terraVec.begin(), terraVec.end());
+    pc2l::sort(terraVec);
     std::cout << "Sorting of vector took "
               << ((sortStart - start) * 1000) / CLOCKS_PER_SEC << "ms"
               << std::endl;
@@ -0,0 +1,1506 @@
+#ifndef ALGORITHM_H
+#define ALGORITHM_H
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+/**
+ * @file Algorithm.h
+ * @brief Algorithms on pc2l::Vector that run on the workers holding the
+ * blocks rather than on the manager
+ * @author JD Rudie
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+
+#include "Kernel.h"
+#include "Vector.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+BEGIN_NAMESPACE(detail);
+
+/**
+ * Obtain a block that a kernel works on from the cache of the worker it
+ * runs on, which owns the block.
+ * @param worker the CacheWorker holding the blocks on this process
+ * @param dsTag the data structure tag of the vector
+ * @param blockTag the tag of the block
+ * @return the block
+ */
+inline MessagePtr findOwnedBlock(CacheWorker &worker, size_t dsTag,
+                                 size_t blockTag) {
+  MessagePtr block = worker.findCacheBlock(dsTag, blockTag);
+  if (block == nullptr) {
+    throw PC2L_EXP("Block %zu of data structure %zu is missing on rank %d",
+                   "The owner of a block must hold it during a kernel",
+                   blockTag, dsTag, MPI_GET_RANK());
+  }
+  return block;
+}
+
+/**
+ * Find the first block at or after a given block that is owned by the
+ * worker this is called on. Blocks are dealt out round robin (see
+ * CacheWorker::getStoredRank), so the blocks a worker owns in a range
+ * are this one and every (ranks - 1)th block after it.
+ * @param blockTag the tag of the first block of a range
+ * @return the tag of the first block in the range owned by this worker
+ */
+inline size_t firstOwnedTag(size_t blockTag) {
+  const size_t rank = MPI_GET_RANK(), workers = MPI_GET_SIZE() - 1;
+  return blockTag + (rank - 1 + workers - blockTag % workers) % workers;
+}
+
+/**
+ * Check whether a block is a zero page, given the [begin, end) pairs of
+ * the runs of zero pages that the manager listed in a kernel message.
+ * Zero pages exist on no worker, so kernels skip them. The blocks must
+ * be checked in increasing order of their tags.
+ * @param zeroRuns the flattened [begin, end) pairs, sorted by begin
+ * @param run the first run that may hold the block, which is advanced
+ * past the runs that end before it
+ * @param blockTag the tag of the block
+ * @return true if the block is a zero page
+ */
+inline bool inZeroRun(const std::vector<size_t> &zeroRuns,
+                      std::vector<size_t>::const_iterator &run,
+                      size_t blockTag) {
+  while (run != zeroRuns.cend() && run[1] <= blockTag) {
+    run += 2;
+  }
+  return run != zeroRuns.cend() && run[0] <= blockTag;
+}
+
+/**
+ * Call \p visit(blockTag, values, begin, end) for each block of \p vec
+ * that is dirty in the manager cache and holds values in [\p first,
+ * \p last), where [begin, end) are the positions of those values in
+ * the block. Kernels that leave the vector cached on the manager process
+ * these blocks there, since the copies held by the workers are stale.
+ * @param vec the vector whose blocks are visited
+ * @param first index of the first value
+ * @param last index one past the last value
+ * @param visit the function to be called for each block
+ * @return the sorted tags of the visited blocks, which the workers skip
+ */
+template <typename Vec, typename Visit>
+std::vector<size_t> visitDirtyBlocks(const Vec &vec, size_t first,
+                                     size_t last, Visit visit) {
+  using T = typename Vec::Iterator::value_type;
+  std::vector<size_t> tags;
+  for (const MessagePtr &block :
+       System::get().cacheManager().getDirtyBlocks(vec.dsTag)) {
+    const size_t blockFirst = block->blockTag * Vec::BlockElementCount;
+    const size_t begin = std::max(first, blockFirst);
+    const size_t end = std::min(last, blockFirst + Vec::BlockElementCount);
+    if (begin < end) {
+      tags.push_back(block->blockTag);
+      visit(block->blockTag, reinterpret_cast<const T *>(block->getPayload()),
+            begin - blockFirst, end - blockFirst);
+    }
+  }
+  std::sort(tags.begin(), tags.end());
+  return tags;
+}
+
+END_NAMESPACE(detail);
+
+/**
+ * The kernel behind pc2l::sort. This is a sample sort that is run by
+ * every process: each worker sorts the values in the blocks it owns,
+ * the manager picks splitters from regular samples of those runs, the
+ * workers exchange values so that worker r ends up with the r-th range
+ * of values, and the sorted ranges are finally written back to the
+ * owners of the blocks they belong in. The manager holds no values and
+ * only takes part in the collective operations.
+ * @tparam T the type of the values in the vector
+ * @tparam BlockSize the size (in bytes) of the blocks of the vector
+ */
+template <typename T, unsigned int BlockSize> struct SortKernel {
+  static constexpr size_t BlockElementCount = BlockSize / sizeof(T);
+
+  /** The largest number of values sent in one MPI message, whose count
+      is an int */
+  static constexpr size_t MaxChunk = std::numeric_limits<int>::max();
+
+  /**
+   * Sort the vector described by \p msg, whose payload holds the kernel
+   * id followed by the number of values in the vector.
+   * @param worker the CacheWorker holding the blocks on this process
+   * @param msg the RUN_KERNEL message
+   */
+  static void run(CacheWorker &worker, const MessagePtr &msg) {
+    const size_t dsTag = msg->dsTag;
+    size_t size;
+    std::memcpy(&size, msg->getPayload() + sizeof(size_t), sizeof(size));
+    const int rank = MPI_GET_RANK(), ranks = MPI_GET_SIZE(),
+              workers = ranks - 1;
+    const size_t blocks = (size + BlockElementCount - 1) / BlockElementCount;
+
+    // Sort the values in the blocks owned by this process
+    std::vector<T> local;
+    for (size_t tag = rank - 1; rank > 0 && tag < blocks; tag += workers) {
+      const T *values = reinterpret_cast<const T *>(
+          detail::findOwnedBlock(worker, dsTag, tag)->getPayload());
+      local.insert(local.end(), values,
+                   values + std::min(BlockElementCount,
+                                     size - tag * BlockElementCount));
+    }
+    std::sort(local.begin(), local.end());
+
+    // Values are counted in units of T rather than bytes, so that the
+    // int counts of MPI go a factor of sizeof(T) further
+    MPI_Datatype valueType;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &valueType);
+    MPI_Type_commit(&valueType);
+
+    // Pick splitters on the manager from regular samples of each run
+    // (at most one per worker from each, so the counts are small)
+    std::vector<T> samples;
+    for (int i = 0; i < workers && !local.empty(); i++) {
+      samples.push_back(local[i * local.size() / workers]);
+    }
+    const int sampleCount = samples.size();
+    std::vector<int> sampleCounts(ranks), sampleDispls(ranks);
+    MPI_Gather(&sampleCount, 1, MPI_INT, sampleCounts.data(), 1, MPI_INT, 0,
+               MPI_COMM_WORLD);
+    std::exclusive_scan(sampleCounts.begin(), sampleCounts.end(),
+                        sampleDispls.begin(), 0);
+    std::vector<T> allSamples(
+        rank == 0 ? sampleDispls.back() + sampleCounts.back() : 0);
+    MPI_Gatherv(samples.data(), sampleCount, valueType, allSamples.data(),
+                sampleCounts.data(), sampleDispls.data(), valueType, 0,
+                MPI_COMM_WORLD);
+    std::vector<T> splitters(workers - 1);
+    if (rank == 0) {
+      std::sort(allSamples.begin(), allSamples.end());
+      for (int i = 1; i < workers; i++) {
+        splitters[i - 1] = allSamples[i * allSamples.size() / workers];
+      }
+    }
+    MPI_Bcast(splitters.data(), splitters.size(), valueType, 0,
+              MPI_COMM_WORLD);
+
+    // Send the values between consecutive splitters to the same worker
+    std::vector<size_t> sendCounts(ranks, 0);
+    auto first = local.begin();
+    for (int i = 0; i < workers; i++) {
+      const auto last =
+          (i + 1 < workers)
+              ? std::upper_bound(first, local.end(), splitters[i])
+              : local.end();
+      sendCounts[i + 1] = std::distance(first, last);
+      first = last;
+    }
+    std::vector<size_t> recvCounts;
+    std::vector<T> bucket = exchange(local, sendCounts, recvCounts, valueType);
+    // Each source sent a sorted run, so merge the runs pairwise
+    for (size_t merged = 0, src = 0; src < recvCounts.size(); src++) {
+      const auto mid = bucket.begin() + merged;
+      merged += recvCounts[src];
+      std::inplace_merge(bucket.begin(), mid, bucket.begin() + merged);
+    }
+    local.clear();
+    local.shrink_to_fit();
+
+    // Worker r now holds the values that go into positions starting
+    // after the values of workers 1..r-1.
+    const unsigned long long bucketSize = bucket.size();
+    std::vector<unsigned long long> bucketSizes(ranks), offsets(ranks + 1, 0);
+    MPI_Allgather(&bucketSize, 1, MPI_UNSIGNED_LONG_LONG, bucketSizes.data(),
+                  1, MPI_UNSIGNED_LONG_LONG, MPI_COMM_WORLD);
+    std::partial_sum(bucketSizes.begin(), bucketSizes.end(),
+                     offsets.begin() + 1);
+
+    // Send the values to the owners of the blocks they belong in. The
+    // values for a given owner are sent in ascending order of position,
+    // which is also the order in which the owner unpacks them.
+    std::fill(sendCounts.begin(), sendCounts.end(), 0);
+    forEachPiece(offsets[rank], offsets[rank + 1],
+                 [&](size_t tag, size_t, size_t count) {
+                   sendCounts[CacheWorker::getStoredRank(tag)] += count;
+                 });
+    std::vector<T> sorted(bucket.size());
+    std::vector<size_t> cursor(ranks, 0);
+    std::exclusive_scan(sendCounts.begin(), sendCounts.end(), cursor.begin(),
+                        size_t(0));
+    size_t next = 0;
+    forEachPiece(offsets[rank], offsets[rank + 1],
+                 [&](size_t tag, size_t, size_t count) {
+                   const int owner = CacheWorker::getStoredRank(tag);
+                   std::copy_n(bucket.begin() + next, count,
+                               sorted.begin() + cursor[owner]);
+                   cursor[owner] += count;
+                   next += count;
+                 });
+    bucket.clear();
+    bucket.shrink_to_fit();
+    const std::vector<T> values =
+        exchange(sorted, sendCounts, recvCounts, valueType);
+    MPI_Type_free(&valueType);
+    next = 0;
+    for (int src = 1; src < ranks; src++) {
+      forEachPiece(offsets[src], offsets[src + 1],
+                   [&](size_t tag, size_t inBlock, size_t count) {
+                     if (CacheWorker::getStoredRank(tag) == rank) {
+                       T *dst = reinterpret_cast<T *>(
+                           detail::findOwnedBlock(worker, dsTag, tag)
+                               ->getPayload());
+                       std::memcpy(static_cast<void *>(dst + inBlock),
+                                   values.data() + next, count * sizeof(T));
+                       next += count;
+                     }
+                   });
+    }
+  }
+
+private:
+
+  /**
+   * Call \p visit(tag, inBlock, count) for each part of the positions
+   * [\p first, \p last) that falls within a single block, in order.
+   * @param first the first position
+   * @param last one past the last position
+   * @param visit callable that is given the block tag, the index of the
+   * first position within the block, and the number of positions
+   */
+  template <typename Visit>
+  static void forEachPiece(size_t first, size_t last, Visit visit) {
+    while (first < last) {
+      const size_t tag = first / BlockElementCount,
+                   inBlock = first % BlockElementCount,
+                   count = std::min(last - first, BlockElementCount - inBlock);
+      visit(tag, inBlock, count);
+      first += count;
+    }
+  }
+
+  /**
+   * Send sendCounts[r] consecutive values of \p values to each rank r,
+   * and receive the values sent to this process by every rank. The
+   * counts and displacements of MPI_Alltoallv are ints, which overflow
+   * for large buckets, so the values are exchanged pairwise instead, in
+   * messages of at most MaxChunk values.
+   * @param values the values to be sent, grouped by destination rank
+   * @param sendCounts the number of values to send to each rank
+   * @param recvCounts set to the number of values received from each rank
+   * @param valueType the MPI datatype of a single value
+   * @return the values received, grouped by source rank
+   */
+  static std::vector<T> exchange(const std::vector<T> &values,
+                                 const std::vector<size_t> &sendCounts,
+                                 std::vector<size_t> &recvCounts,
+                                 MPI_Datatype valueType) {
+    const int ranks = sendCounts.size(), rank = MPI_GET_RANK();
+    std::vector<unsigned long long> sent(sendCounts.begin(), sendCounts.end()),
+        got(ranks);
+    MPI_Alltoall(sent.data(), 1, MPI_UNSIGNED_LONG_LONG, got.data(), 1,
+                 MPI_UNSIGNED_LONG_LONG, MPI_COMM_WORLD);
+    recvCounts.assign(got.begin(), got.end());
+    std::vector<T> received(
+        std::accumulate(recvCounts.begin(), recvCounts.end(), size_t(0)));
+    std::vector<MPI_Request> reqs;
+    for (size_t r = 0, sendAt = 0, recvAt = 0; r < sendCounts.size();
+         sendAt += sendCounts[r], recvAt += recvCounts[r], r++) {
+      if (static_cast<int>(r) == rank) {
+        std::copy_n(values.begin() + sendAt, sendCounts[r],
+                    received.begin() + recvAt);
+        continue;
+      }
+      // the chunks from a given rank arrive in the order they were sent
+      for (size_t done = 0; done < recvCounts[r]; done += MaxChunk) {
+        reqs.emplace_back();
+        MPI_Irecv(received.data() + recvAt + done,
+                  static_cast<int>(std::min(recvCounts[r] - done, MaxChunk)),
+                  valueType, r,
+                  Message::RUN_KERNEL, MPI_COMM_WORLD, &reqs.back());
+      }
+      for (size_t done = 0; done < sendCounts[r]; done += MaxChunk) {
+        reqs.emplace_back();
+        MPI_Isend(values.data() + sendAt + done,
+                  static_cast<int>(std::min(sendCounts[r] - done, MaxChunk)),
+                  valueType, r,
+                  Message::RUN_KERNEL, MPI_COMM_WORLD, &reqs.back());
+      }
+    }
+    MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+    return received;
+  }
+};
+
+/**
+ * Sort a vector in ascending order. The values are sorted by the workers
+ * that hold the blocks (see SortKernel) and data moves directly between
+ * workers, so the manager only coordinates. Cached blocks of the vector
+ * are written back to their owners first. When the workers are not
+ * running (e.g., on worker processes once the manager has stopped the
+ * system) the values are sorted locally instead.
+ * @param vec the vector to be sorted
+ */
+template <typename T, unsigned int UserBlockSize, unsigned int PrefetchCount,
+          PrefetchStrategy PFStrategy>
+void sort(Vector<T, UserBlockSize, PrefetchCount, PFStrategy> &vec) {
+  using Vec = Vector<T, UserBlockSize, PrefetchCount, PFStrategy>;
+  using Sorter = SortKernel<T, Vec::BlockSize>;
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Values must be trivially copyable to be sorted by workers");
+  if (vec.size() < 2) {
+    return;
+  }
+  CacheManager &cm = System::get().cacheManager();
+  if (!cm.workersRunning()) {
+    std::vector<T> values(vec.size());
+    vec.read(0, values.size(), values.data());
+    std::sort(values.begin(), values.end());
+    vec.assign(values.begin(), values.end());
+    return;
+  }
+  const size_t blocks =
+      (vec.size() + Vec::BlockElementCount - 1) / Vec::BlockElementCount;
+  // the kernel works on the blocks held by the workers
+  vec.materializeZeroPages();
+  cm.flushDataStructure(vec.dsTag, blocks);
+  vec.prevMsg = nullptr;
+
+  const size_t id = RegisteredKernel<Sorter>::id, size = vec.size();
+  MessagePtr msg = Message::create(2 * sizeof(size_t), Message::RUN_KERNEL,
+                                   0, vec.dsTag, 0);
+  std::memcpy(msg->getPayload(), &id, sizeof(id));
+  std::memcpy(msg->getPayload() + sizeof(id), &size, sizeof(size));
+  cm.launchKernel(msg);
+}
+
+/**
+ * Trait that is true for iterators over a pc2l::Vector. The values of a
+ * vector lie in contiguous runs (one per block), which the algorithms
+ * below walk with tight loops rather than one iterator call per value.
+ */
+template <typename It, typename = void>
+struct IsSegmentedIterator : std::false_type {};
+
+template <typename It>
+struct IsSegmentedIterator<It, std::void_t<typename It::vector_type>>
+    : std::true_type {};
+
+/**
+ * Shortcut to enable an algorithm only for iterators over a pc2l::Vector
+ */
+template <typename It, typename R = void>
+using EnableIfSegmented = std::enable_if_t<IsSegmentedIterator<It>::value, R>;
+
+/**
+ * The kernel behind the worker-side pc2l::for_each and pc2l::transform.
+ * Each worker applies an operation to the values in a range of indices
+ * that lie in the blocks it owns, in place. Results of a transform into
+ * another vector go to the block with the same tag in that vector, which
+ * is owned by the same worker. The manager holds none of the blocks
+ * while the kernel runs, so it has nothing to do.
+ * @tparam T the type of the values in the vector
+ * @tparam BlockElementCount the number of values in each block
+ * @tparam Op the type of the operation, which is copied bytewise into
+ * the RUN_KERNEL message
+ * @tparam Transform if true, op(value) is stored in the output vector,
+ * otherwise op(value) is called for each value (as std::for_each does)
+ */
+template <typename T, size_t BlockElementCount, typename Op, bool Transform>
+struct ElementwiseKernel {
+  /** The arguments in the payload of the RUN_KERNEL message */
+  struct Args {
+    size_t id;       /**< the kernel id */
+    size_t first;    /**< index of the first value */
+    size_t last;     /**< index one past the last value */
+    size_t outDsTag; /**< data structure tag of the output vector */
+  };
+
+  /**
+   * Apply the operation that follows the Args in the payload of \p msg
+   * to the values of the blocks of the vector msg->dsTag owned by this
+   * process.
+   * @param worker the CacheWorker holding the blocks on this process
+   * @param msg the RUN_KERNEL message
+   */
+  static void run(CacheWorker &worker, const MessagePtr &msg) {
+    const size_t workers = MPI_GET_SIZE() - 1;
+    if (MPI_GET_RANK() == 0) {
+      return;
+    }
+    Args args;
+    std::memcpy(&args, msg->getPayload(), sizeof(Args));
+    alignas(Op) unsigned char opBytes[sizeof(Op)];
+    std::memcpy(opBytes, msg->getPayload() + sizeof(Args), sizeof(Op));
+    Op &op = *std::launder(reinterpret_cast<Op *>(opBytes));
+    const size_t endTag = (args.last - 1) / BlockElementCount + 1;
+    for (size_t tag = detail::firstOwnedTag(args.first / BlockElementCount);
+         tag < endTag; tag += workers) {
+      const size_t blockFirst = tag * BlockElementCount;
+      const size_t begin = std::max(args.first, blockFirst) - blockFirst;
+      const size_t end =
+          std::min(args.last, blockFirst + BlockElementCount) - blockFirst;
+      T *values = reinterpret_cast<T *>(
+          detail::findOwnedBlock(worker, msg->dsTag, tag)->getPayload());
+      if constexpr (Transform) {
+        T *out = (args.outDsTag == msg->dsTag)
+                     ? values
+                     : reinterpret_cast<T *>(
+                           detail::findOwnedBlock(worker, args.outDsTag, tag)
+                               ->getPayload());
+        std::transform(values + begin, values + end, out + begin, op);
+      } else {
+        std::for_each(values + begin, values + end, std::ref(op));
+      }
+    }
+  }
+};
+
+/**
+ * Trait that is true for operations that the workers can run from a
+ * bytewise copy made on the manager. Being trivially copyable is not
+ * enough: function pointers and lambdas that capture by reference hold
+ * addresses that mean nothing in another process. So only empty class
+ * types (e.g., std::plus<> or lambdas without captures) are portable by
+ * default. Specialize the trait, or wrap the operation with
+ * pc2l::portable, for other operations whose state is self-contained.
+ */
+template <typename Op>
+struct IsPortable
+    : std::bool_constant<std::is_class_v<Op> && std::is_empty_v<Op>> {};
+
+/**
+ * Wrapper that marks an operation as portable (see IsPortable), e.g., a
+ * lambda that captures values only. Use pc2l::portable to create one.
+ */
+template <typename Op> struct Portable {
+  static_assert(std::is_class_v<Op>,
+                "Function pointers differ between processes");
+
+  Op op; /**< the wrapped operation */
+
+  /**
+   * Call the wrapped operation.
+   * @param args the arguments passed on to the operation
+   * @return the result of the operation
+   */
+  template <typename... Args> decltype(auto) operator()(Args &&...args) {
+    return op(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Call the wrapped operation.
+   * @param args the arguments passed on to the operation
+   * @return the result of the operation
+   */
+  template <typename... Args>
+  decltype(auto) operator()(Args &&...args) const {
+    return op(std::forward<Args>(args)...);
+  }
+};
+
+template <typename Op>
+struct IsPortable<Portable<Op>> : std::is_trivially_copyable<Op> {};
+
+/**
+ * Mark an operation as portable, so that the algorithms below may send
+ * it to the workers. The caller vouches that \p op holds no pointers or
+ * references, i.e., that it captures values only. Operations that are
+ * not trivially copyable still run on the manager.
+ *
+ * \code
+ * pc2l::count_if(vec.begin(), vec.end(),
+ *                pc2l::portable([limit](int v) { return v > limit; }));
+ * \endcode
+ *
+ * @param op the operation to be marked
+ * @return the wrapped operation
+ */
+template <typename Op> Portable<Op> portable(Op op) { return {op}; }
+
+/**
+ * Check whether an elementwise pass over the values [\p first, \p last)
+ * of \p vec is to be run on the workers (see ElementwiseKernel). That
+ * needs the workers to be running, values that can be copied bytewise
+ * and portable operations (see IsPortable). Ranges that fit into the
+ * manager cache are cheaper to walk on the manager, so they are not
+ * sent to the workers.
+ * @tparam Ops the types of the operations
+ * @param vec the vector the values belong to
+ * @param first index of the first value
+ * @param last index one past the last value
+ * @return true if the pass is to be run on the workers
+ */
+template <typename... Ops, typename Vec>
+bool runOnWorkers(const Vec &vec, size_t first, size_t last) {
+  using T = typename Vec::Iterator::value_type;
+  if constexpr (!std::is_trivially_copyable_v<T> ||
+                !(IsPortable<Ops>::value && ...)) {
+    return false;
+  } else {
+    const CacheManager &cm = System::get().cacheManager();
+    const size_t cacheBlocks =
+        cm.cacheSize / (Vec::BlockSize + sizeof(Message));
+    return cm.workersRunning() && first < last &&
+           (last - 1) / Vec::BlockElementCount - first / Vec::BlockElementCount >=
+               cacheBlocks;
+  }
+}
+
+/**
+ * Run an ElementwiseKernel over the values [\p first, \p last) of
+ * \p vec. The vectors involved are flushed first, so that the workers
+ * hold the only (and current) copy of each of their blocks.
+ * @tparam K the ElementwiseKernel to be run
+ * @param vec the vector whose values the operation is applied to
+ * @param first index of the first value
+ * @param last index one past the last value
+ * @param out the vector the results are stored in (for a transform)
+ * @param op the operation to be applied
+ */
+template <typename K, typename Vec, typename Op>
+void launchElementwise(Vec &vec, size_t first, size_t last, Vec &out,
+                       const Op &op) {
+  CacheManager &cm = System::get().cacheManager();
+  for (Vec *v : {&vec, &out}) {
+    v->materializeZeroPages();
+    cm.flushDataStructure(v->dsTag, (v->size() + Vec::BlockElementCount - 1) /
+                                        Vec::BlockElementCount);
+    v->prevMsg = nullptr;
+  }
+  const typename K::Args args{RegisteredKernel<K>::id, first, last,
+                              out.dsTag};
+  MessagePtr msg = Message::create(sizeof(args) + sizeof(Op),
+                                   Message::RUN_KERNEL, 0, vec.dsTag, 0);
+  std::memcpy(msg->getPayload(), &args, sizeof(args));
+  std::memcpy(msg->getPayload() + sizeof(args), static_cast<const void *>(&op),
+              sizeof(Op));
+  cm.launchKernel(msg);
+}
+
+/**
+ * Same as std::for_each, but the function is applied by the workers to
+ * the values in the blocks they own when the range is larger than the
+ * manager cache (see runOnWorkers), so that the values never cross the
+ * network. Otherwise the values are walked a block at a time on the
+ * manager. Since the workers apply copies of \p fn, any state that
+ * \p fn accumulates is only returned when it runs on the manager; for
+ * the same reason only portable functions are sent to the workers (see
+ * IsPortable).
+ * @param first iterator to the first value
+ * @param last iterator one past the last value
+ * @param fn the function to be called with (a reference to) each value
+ * @return \p fn
+ */
+template <typename It, typename UnaryFn>
+EnableIfSegmented<It, UnaryFn> for_each(It first, It last, UnaryFn fn) {
+  using Vec = typename It::vector_type;
+  using T = typename It::value_type;
+  auto &vec = first.container();
+  if (runOnWorkers<UnaryFn>(vec, first.i, last.i)) {
+    using K = ElementwiseKernel<T, Vec::BlockElementCount, UnaryFn, false>;
+    launchElementwise<K>(vec, first.i, last.i, vec, fn);
+    return fn;
+  }
+  vec.for_each_segment(first.i, last.i, [&fn](auto *values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      fn(values[i]);
+    }
+  });
+  return fn;
+}
+
+/**
+ * Call \p fn(T *values, size_t count) once for each run of values in
+ * [\p first, \p last) that is contiguous in memory. See
+ * Vector::for_each_segment.
+ * @param first iterator to the first value
+ * @param last iterator one past the last value
+ * @param fn callable that is given each run of values
+ */
+template <typename It, typename Fn>
+EnableIfSegmented<It> for_each_segment(It first, It last, Fn fn) {
+  first.container().for_each_segment(first.i, last.i, fn);
+}
+
+/**
+ * Same as std::copy, but reads the values a block at a time.
+ * @param first iterator to the first value to be copied
+ * @param last iterator one past the last value to be copied
+ * @param out output iterator to which the values are copied
+ * @return output iterator one past the last value copied
+ */
+template <typename It, typename OutputIt>
+EnableIfSegmented<It, OutputIt> copy(It first, It last, OutputIt out) {
+  std::as_const(first.container())
+      .for_each_segment(first.i, last.i,
+                        [&out](const auto *values, size_t count) {
+                          out = std::copy_n(values, count, out);
+                        });
+  return out;
+}
+
+/**
+ * Same as std::fill, but writes the values a block at a time.
+ * @param first iterator to the first value to be assigned
+ * @param last iterator one past the last value to be assigned
+ * @param value the value to be assigned
+ */
+template <typename It, typename T>
+EnableIfSegmented<It> fill(It first, It last, const T &value) {
+  first.container().for_each_segment(
+      first.i, last.i,
+      [&value](auto *values, size_t count) {
+        std::fill_n(values, count, value);
+      });
+}
+
+/**
+ * Same as std::transform (the unary version), but reads the values a
+ * block at a time. When \p out is \p first, i.e., the values are
+ * transformed in place, they are also written a block at a time. When
+ * \p out points to the same index of a vector of the same type (\p
+ * first's vector included), large ranges are transformed by the workers
+ * that own the blocks, as in pc2l::for_each.
+ * @param first iterator to the first value to be transformed
+ * @param last iterator one past the last value to be transformed
+ * @param out output iterator to which the results are written
+ * @param op the unary operation to be applied to each value
+ * @return output iterator one past the last result written
+ */
+template <typename It, typename OutputIt, typename UnaryOp>
+EnableIfSegmented<It, OutputIt> transform(It first, It last, OutputIt out,
+                                          UnaryOp op) {
+  if constexpr (std::is_same_v<It, OutputIt>) {
+    using Vec = typename It::vector_type;
+    using T = typename It::value_type;
+    if (out.i == first.i && out.container().size() >= last.i &&
+        runOnWorkers<UnaryOp>(first.container(), first.i, last.i)) {
+      using K = ElementwiseKernel<T, Vec::BlockElementCount, UnaryOp, true>;
+      launchElementwise<K>(first.container(), first.i, last.i,
+                           out.container(), op);
+      return out + (last.i - first.i);
+    }
+    if (&out.container() == &first.container() && out.i == first.i) {
+      first.container().for_each_segment(
+          first.i, last.i, [&op](auto *values, size_t count) {
+            std::transform(values, values + count, values, op);
+          });
+      return out + (last.i - first.i);
+    }
+  }
+  std::as_const(first.container())
+      .for_each_segment(first.i, last.i,
+                        [&](const auto *values, size_t count) {
+                          out = std::transform(values, values + count, out,
+                                               op);
+                        });
+  return out;
+}
+
+/**
+ * Same as std::accumulate, but reads the values a block at a time.
+ * @param first iterator to the first value to be summed up
+ * @param last iterator one past the last value to be summed up
+ * @param init the initial value of the sum
+ * @param op the binary operation that adds a value to the sum
+ * @return the sum of \p init and the values
+ */
+template <typename It, typename T, typename BinaryOp = std::plus<>>
+EnableIfSegmented<It, T> accumulate(It first, It last, T init,
+                                    BinaryOp op = BinaryOp()) {
+  std::as_const(first.container())
+      .for_each_segment(first.i, last.i,
+                        [&](const auto *values, size_t count) {
+                          init = std::accumulate(values, values + count,
+                                                 std::move(init), op);
+                        });
+  return init;
+}
+
+/** What a SearchKernel reports about the values matching a predicate */
+enum SearchMode {
+  FIND_FIRST, /**< the index of the first match */
+  COUNT,      /**< the number of matches */
+  FIND_ALL    /**< the indices of all matches */
+};
+
+/**
+ * The kernel behind the worker-side pc2l::find_if, pc2l::count_if and
+ * pc2l::find_all. Each worker evaluates the predicate on the values in
+ * the blocks it owns and only the matches are sent to the manager: the
+ * earliest match (with MPI_MIN) or the number of matches (with MPI_SUM)
+ * are combined with MPI_Reduce, and the indices of all matches are
+ * sent to the manager in chunks of at most MaxChunk indices. As in
+ * ReduceKernel, the manager searches its dirty cached blocks and the
+ * runs of zero pages itself and lists them in the message, so the
+ * vector is not flushed and no zero page is created.
+ * @tparam T the type of the values in the vector
+ * @tparam BlockElementCount the number of values in each block
+ * @tparam Pred the type of the predicate, which is copied bytewise into
+ * the RUN_KERNEL message
+ * @tparam Mode what is reported about the matches
+ */
+template <typename T, size_t BlockElementCount, typename Pred,
+          SearchMode Mode>
+struct SearchKernel {
+  /** The arguments at the start of the payload of the RUN_KERNEL message */
+  struct Args {
+    size_t id;           /**< the kernel id */
+    size_t first;        /**< index of the first value */
+    size_t last;         /**< index one past the last value */
+    size_t skipCount;    /**< the number of blocks searched by the manager */
+    size_t zeroRunCount; /**< the number of runs of zero pages */
+    size_t result;       /**< the first match or count (see scan) */
+  };
+
+  /** The most indices sent in one message, as MPI counts are ints */
+  static constexpr size_t MaxChunk = std::numeric_limits<int>::max();
+
+  /** Offsets of the remaining parts of the payload */
+  static constexpr size_t PredOffset = sizeof(Args);
+  static constexpr size_t SkipOffset = PredOffset + sizeof(Pred);
+
+  /**
+   * Search the vector described by \p msg. On the manager, the combined
+   * result replaces the manager's own result in the payload of \p msg.
+   * @param worker the CacheWorker holding the blocks on this process
+   * @param msg the RUN_KERNEL message
+   */
+  static void run(CacheWorker &worker, const MessagePtr &msg) {
+    const int rank = MPI_GET_RANK(), ranks = MPI_GET_SIZE();
+    const size_t workers = ranks - 1;
+    Args args;
+    std::memcpy(&args, msg->getPayload(), sizeof(Args));
+    alignas(Pred) unsigned char predBytes[sizeof(Pred)];
+    std::memcpy(predBytes, msg->getPayload() + PredOffset, sizeof(Pred));
+    Pred &pred = *std::launder(reinterpret_cast<Pred *>(predBytes));
+
+    unsigned long long result = initial(args.last);
+    std::vector<size_t> hits;
+    if (rank == 0) {
+      result = args.result;
+    } else {
+      // the manager sorted the tags of the blocks it searched, and the
+      // [begin, end) pairs of the runs of zero pages
+      std::vector<size_t> skip(args.skipCount);
+      std::vector<size_t> zeroRuns(2 * args.zeroRunCount);
+      std::memcpy(skip.data(), msg->getPayload() + SkipOffset,
+                  skip.size() * sizeof(size_t));
+      std::memcpy(zeroRuns.data(),
+                  msg->getPayload() + SkipOffset + skip.size() * sizeof(size_t),
+                  zeroRuns.size() * sizeof(size_t));
+      const size_t endTag = (args.last - 1) / BlockElementCount + 1;
+      auto run = zeroRuns.cbegin();
+      for (size_t tag = detail::firstOwnedTag(args.first / BlockElementCount);
+           tag < endTag; tag += workers) {
+        if (detail::inZeroRun(zeroRuns, run, tag) ||
+            std::binary_search(skip.begin(), skip.end(), tag)) {
+          continue;
+        }
+        const size_t blockFirst = tag * BlockElementCount;
+        const T *values = reinterpret_cast<const T *>(
+            detail::findOwnedBlock(worker, msg->dsTag, tag)->getPayload());
+        // the blocks are visited in order, so the first match is final
+        if (scan(values, blockFirst, std::max(args.first, blockFirst) - blockFirst,
+                 std::min(args.last, blockFirst + BlockElementCount) -
+                     blockFirst,
+                 pred, result, hits)) {
+          break;
+        }
+      }
+    }
+
+    if constexpr (Mode == FIND_ALL) {
+      static_assert(sizeof(size_t) == sizeof(unsigned long),
+                    "Indices are sent as MPI_UNSIGNED_LONG");
+      const unsigned long long count = hits.size();
+      std::vector<unsigned long long> counts(ranks);
+      MPI_Gather(&count, 1, MPI_UNSIGNED_LONG_LONG, counts.data(), 1,
+                 MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+      if (rank == 0) {
+        std::vector<size_t> &all = gathered();
+        size_t offset = all.size();
+        all.resize(offset +
+                   std::accumulate(counts.begin(), counts.end(), 0ULL));
+        std::vector<MPI_Request> reqs;
+        for (int src = 1; src < ranks; src++) {
+          for (size_t done = 0; done < counts[src]; done += MaxChunk) {
+            reqs.emplace_back();
+            MPI_Irecv(all.data() + offset + done,
+                      std::min<size_t>(MaxChunk, counts[src] - done),
+                      MPI_UNSIGNED_LONG, src, Message::RUN_KERNEL,
+                      MPI_COMM_WORLD, &reqs.back());
+          }
+          offset += counts[src];
+        }
+        MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+        std::sort(all.begin(), all.end());
+      } else {
+        for (size_t done = 0; done < hits.size(); done += MaxChunk) {
+          MPI_Send(hits.data() + done,
+                   std::min<size_t>(MaxChunk, hits.size() - done),
+                   MPI_UNSIGNED_LONG, 0, Message::RUN_KERNEL, MPI_COMM_WORLD);
+        }
+      }
+    } else {
+      unsigned long long combined = result;
+      MPI_Reduce(&result, &combined, 1, MPI_UNSIGNED_LONG_LONG,
+                 (Mode == FIND_FIRST) ? MPI_MIN : MPI_SUM, 0, MPI_COMM_WORLD);
+      if (rank == 0) {
+        args.result = combined;
+        std::memcpy(msg->getPayload(), &args, sizeof(Args));
+      }
+    }
+  }
+
+  /**
+   * The indices of all matches (for FIND_ALL) on the manager. They are
+   * collected here rather than through a pointer in the message, which
+   * only holds what means the same on every process.
+   * @return the indices of the matches found so far
+   */
+  static std::vector<size_t> &gathered() {
+    static std::vector<size_t> hits;
+    return hits;
+  }
+
+  /**
+   * The result before any values are searched.
+   * @param last index one past the last value
+   * @return \p last if looking for the first match, otherwise zero
+   */
+  static size_t initial(size_t last) {
+    return (Mode == FIND_FIRST) ? last : 0;
+  }
+
+  /**
+   * Evaluate the predicate on the values at positions [\p begin,
+   * \p end) of a block.
+   * @param values the values in the block
+   * @param blockFirst the index of the first value in the block
+   * @param begin position of the first value to be examined
+   * @param end position one past the last value to be examined
+   * @param pred the predicate
+   * @param result the smallest index of a match (for FIND_FIRST) or the
+   * number of matches (for COUNT), which is updated
+   * @param hits the indices of matches (for FIND_ALL) are appended here
+   * @return true if a match was found and only the first one is wanted
+   */
+  template <typename Result>
+  static bool scan(const T *values, size_t blockFirst, size_t begin,
+                   size_t end, Pred &pred, Result &result,
+                   std::vector<size_t> &hits) {
+    if constexpr (Mode == FIND_FIRST) {
+      const T *hit = std::find_if(values + begin, values + end, std::ref(pred));
+      if (hit != values + end) {
+        result = std::min<Result>(result, blockFirst + (hit - values));
+        return true;
+      }
+    } else if constexpr (Mode == COUNT) {
+      result += std::count_if(values + begin, values + end, std::ref(pred));
+    } else {
+      for (size_t i = begin; i < end; i++) {
+        if (pred(values[i])) {
+          hits.push_back(blockFirst + i);
+        }
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * Run a SearchKernel over the values [\p first, \p last) of \p vec.
+ * The manager searches its dirty cached blocks and the runs of zero
+ * pages before the kernel is launched; the predicate is evaluated once
+ * per run of zero pages.
+ * @tparam Mode what is reported about the matches
+ * @param vec the vector to be searched
+ * @param first index of the first value
+ * @param last index one past the last value
+ * @param pred the predicate
+ * @param hits the sorted indices of all matches (for FIND_ALL) are
+ * appended here
+ * @return the index of the first match or \p last (for FIND_FIRST), or
+ * the number of matches (for COUNT)
+ */
+template <SearchMode Mode, typename Vec, typename UnaryPred>
+size_t searchOnWorkers(Vec &vec, size_t first, size_t last, UnaryPred pred,
+                       std::vector<size_t> *hits = nullptr) {
+  using T = typename Vec::Iterator::value_type;
+  using K = SearchKernel<T, Vec::BlockElementCount, UnaryPred, Mode>;
+  std::vector<size_t> managerHits;
+  size_t result = K::initial(last);
+  const std::vector<size_t> skip = detail::visitDirtyBlocks(
+      vec, first, last,
+      [&](size_t blockTag, const T *values, size_t begin, size_t end) {
+        K::scan(values, blockTag * Vec::BlockElementCount, begin, end, pred,
+                result, managerHits);
+      });
+  std::vector<size_t> zeroRuns;
+  for (const auto &[begin, end] : vec.zeroRuns) {
+    const size_t runFirst = std::max(first, begin * Vec::BlockElementCount);
+    const size_t runLast = std::min(last, end * Vec::BlockElementCount);
+    if (runFirst >= runLast) {
+      continue;
+    }
+    zeroRuns.push_back(begin);
+    zeroRuns.push_back(end);
+    if (!pred(T{})) {
+      continue;
+    }
+    if constexpr (Mode == FIND_FIRST) {
+      result = std::min(result, runFirst);
+    } else if constexpr (Mode == COUNT) {
+      result += runLast - runFirst;
+    } else {
+      for (size_t i = runFirst; i < runLast; i++) {
+        managerHits.push_back(i);
+      }
+    }
+  }
+
+  const typename K::Args args{RegisteredKernel<K>::id,
+                              first,
+                              last,
+                              skip.size(),
+                              zeroRuns.size() / 2,
+                              result};
+  MessagePtr msg = Message::create(
+      K::SkipOffset + (skip.size() + zeroRuns.size()) * sizeof(size_t),
+      Message::RUN_KERNEL, 0, vec.dsTag, 0);
+  std::memcpy(msg->getPayload(), &args, sizeof(args));
+  std::memcpy(msg->getPayload() + K::PredOffset,
+              static_cast<const void *>(&pred), sizeof(UnaryPred));
+  std::memcpy(msg->getPayload() + K::SkipOffset, skip.data(),
+              skip.size() * sizeof(size_t));
+  std::memcpy(msg->getPayload() + K::SkipOffset +
+                  skip.size() * sizeof(size_t),
+              zeroRuns.data(), zeroRuns.size() * sizeof(size_t));
+  K::gathered().swap(managerHits);
+  System::get().cacheManager().launchKernel(msg);
+  K::gathered().swap(managerHits);
+  if (hits != nullptr) {
+    hits->insert(hits->end(), managerHits.begin(), managerHits.end());
+  }
+  typename K::Args done;
+  std::memcpy(&done, msg->getPayload(), sizeof(done));
+  return done.result;
+}
+
+/**
+ * Same as std::find_if, but reads the values a block at a time and stops
+ * at the block containing the first match. When the range is larger
+ * than the manager cache, the predicate is evaluated by the workers on
+ * the blocks they own and only the earliest match of each is sent to
+ * the manager (see SearchKernel).
+ * @param first iterator to the first value to be examined
+ * @param last iterator one past the last value to be examined
+ * @param pred predicate that returns true for the value being looked for
+ * @return iterator to the first match, or \p last if there is none
+ */
+template <typename It, typename UnaryPred>
+EnableIfSegmented<It, It> find_if(It first, It last, UnaryPred pred) {
+  if (runOnWorkers<UnaryPred>(first.container(), first.i, last.i)) {
+    return first + (searchOnWorkers<FIND_FIRST>(first.container(), first.i,
+                                                last.i, pred) -
+                    first.i);
+  }
+  size_t index = first.i;
+  std::as_const(first.container())
+      .for_each_segment(first.i, last.i,
+                        [&](const auto *values, size_t count) {
+                          const auto hit =
+                              std::find_if(values, values + count, pred);
+                          index += hit - values;
+                          return hit == values + count;
+                        });
+  return first + (index - first.i);
+}
+
+/**
+ * Same as std::find, but reads the values a block at a time and stops at
+ * the block containing the first match.
+ * @param first iterator to the first value to be examined
+ * @param last iterator one past the last value to be examined
+ * @param value the value being looked for
+ * @return iterator to the first match, or \p last if there is none
+ */
+template <typename It, typename T>
+EnableIfSegmented<It, It> find(It first, It last, const T &value) {
+  // capture the value by copy, so that the predicate can be sent to the
+  // workers
+  return pc2l::find_if(
+      first, last, portable([value](const auto &v) { return v == value; }));
+}
+
+/**
+ * Same as std::count_if, but reads the values a block at a time. Large
+ * ranges are counted by the workers, as in pc2l::find_if.
+ * @param first iterator to the first value to be examined
+ * @param last iterator one past the last value to be examined
+ * @param pred predicate that returns true for the values to be counted
+ * @return the number of values for which \p pred returns true
+ */
+template <typename It, typename UnaryPred>
+EnableIfSegmented<It, size_t> count_if(It first, It last, UnaryPred pred) {
+  if (runOnWorkers<UnaryPred>(first.container(), first.i, last.i)) {
+    return searchOnWorkers<COUNT>(first.container(), first.i, last.i, pred);
+  }
+  size_t count = 0;
+  std::as_const(first.container())
+      .for_each_segment(first.i, last.i,
+                        [&](const auto *values, size_t n) {
+                          count += std::count_if(values, values + n, pred);
+                        });
+  return count;
+}
+
+/**
+ * Find the indices of all values for which a predicate returns true.
+ * Large ranges are searched by the workers, as in pc2l::find_if, so
+ * that only the indices of the matches are sent to the manager.
+ * @param first iterator to the first value to be examined
+ * @param last iterator one past the last value to be examined
+ * @param pred predicate that returns true for the values being looked for
+ * @return the indices of the matches, in increasing order
+ */
+template <typename It, typename UnaryPred>
+EnableIfSegmented<It, std::vector<size_t>> find_all(It first, It last,
+                                                    UnaryPred pred) {
+  std::vector<size_t> hits;
+  if (runOnWorkers<UnaryPred>(first.container(), first.i, last.i)) {
+    searchOnWorkers<FIND_ALL>(first.container(), first.i, last.i, pred, &hits);
+    return hits;
+  }
+  size_t index = first.i;
+  std::as_const(first.container())
+      .for_each_segment(first.i, last.i,
+                        [&](const auto *values, size_t count) {
+                          for (size_t i = 0; i < count; i++, index++) {
+                            if (pred(values[i])) {
+                              hits.push_back(index);
+                            }
+                          }
+                        });
+  return hits;
+}
+
+/**
+ * Same as std::equal, but reads the values of the first range a block at
+ * a time and stops at the first block with a mismatch.
+ * @param first1 iterator to the first value of the first range
+ * @param last1 iterator one past the last value of the first range
+ * @param first2 iterator to the first value of the second range
+ * @return true if the ranges hold equal values
+ */
+template <typename It, typename InputIt>
+EnableIfSegmented<It, bool> equal(It first1, It last1, InputIt first2) {
+  bool equal = true;
+  std::as_const(first1.container())
+      .for_each_segment(first1.i, last1.i,
+                        [&](const auto *values, size_t count) {
+                          equal = std::equal(values, values + count, first2);
+                          std::advance(first2, count);
+                          return equal;
+                        });
+  return equal;
+}
+
+/** Binary operation that yields the smaller of two values */
+struct Min {
+  template <typename T>
+  constexpr const T &operator()(const T &lhs, const T &rhs) const {
+    return std::min(lhs, rhs);
+  }
+};
+
+/** Binary operation that yields the larger of two values */
+struct Max {
+  template <typename T>
+  constexpr const T &operator()(const T &lhs, const T &rhs) const {
+    return std::max(lhs, rhs);
+  }
+};
+
+/**
+ * Trait mapping a result type to the MPI datatype used to reduce it
+ * with MPI_Reduce. Types without a builtin datatype are combined with
+ * point-to-point messages instead (see ReduceKernel).
+ */
+template <typename R> struct MpiDatatype : std::false_type {};
+
+#define PC2L_MPI_DATATYPE(Type, Datatype)                                      \
+  template <> struct MpiDatatype<Type> : std::true_type {                      \
+    static MPI_Datatype get() { return Datatype; }                             \
+  }
+PC2L_MPI_DATATYPE(int, MPI_INT);
+PC2L_MPI_DATATYPE(unsigned int, MPI_UNSIGNED);
+PC2L_MPI_DATATYPE(long, MPI_LONG);
+PC2L_MPI_DATATYPE(unsigned long, MPI_UNSIGNED_LONG);
+PC2L_MPI_DATATYPE(long long, MPI_LONG_LONG);
+PC2L_MPI_DATATYPE(unsigned long long, MPI_UNSIGNED_LONG_LONG);
+PC2L_MPI_DATATYPE(float, MPI_FLOAT);
+PC2L_MPI_DATATYPE(double, MPI_DOUBLE);
+#undef PC2L_MPI_DATATYPE
+
+/**
+ * Trait mapping a binary operation to the builtin MPI operation that
+ * does the same, along with its identity (which is what processes
+ * without any values contribute to MPI_Reduce).
+ */
+template <typename Op, typename R> struct MpiOp : std::false_type {};
+
+template <typename R> struct MpiOp<std::plus<>, R> : std::true_type {
+  static MPI_Op get() { return MPI_SUM; }
+  static R identity() { return R(0); }
+};
+template <typename R> struct MpiOp<std::plus<R>, R> : MpiOp<std::plus<>, R> {};
+
+template <typename R> struct MpiOp<std::multiplies<>, R> : std::true_type {
+  static MPI_Op get() { return MPI_PROD; }
+  static R identity() { return R(1); }
+};
+template <typename R>
+struct MpiOp<std::multiplies<R>, R> : MpiOp<std::multiplies<>, R> {};
+
+template <typename R> struct MpiOp<Min, R> : std::true_type {
+  static MPI_Op get() { return MPI_MIN; }
+  static R identity() { return std::numeric_limits<R>::max(); }
+};
+
+template <typename R> struct MpiOp<Max, R> : std::true_type {
+  static MPI_Op get() { return MPI_MAX; }
+  static R identity() { return std::numeric_limits<R>::lowest(); }
+};
+
+/**
+ * The kernel behind pc2l::reduce and pc2l::transform_reduce. Each worker
+ * folds the (transformed) values in the blocks it owns into a partial
+ * result, which are then combined on the manager: with MPI_Reduce when
+ * the operation and result type have MPI builtins, and otherwise along a
+ * binomial tree of point-to-point messages, so that the manager receives
+ * log2(ranks) partial results rather than one per worker.
+ *
+ * The manager does not flush the vector. It folds its dirty cached
+ * blocks into the initial value itself and lists their tags in the
+ * message, so the workers skip their stale copies. Zero pages exist on
+ * no worker, so the manager folds them in as well, a run of them at a
+ * time, and lists the runs in the message. The combined result
+ * replaces the manager's partial result in the payload of the message.
+ * Results are copied bytewise, so R need not be default constructible.
+ * @tparam T the type of the values in the vector
+ * @tparam BlockElementCount the number of values in each block
+ * @tparam R the type of the result
+ * @tparam ReduceOp the type of the (associative and commutative) binary
+ * operation that combines results
+ * @tparam TransformOp the type of the unary operation applied to each
+ * value before it is combined
+ */
+template <typename T, size_t BlockElementCount, typename R,
+          typename ReduceOp, typename TransformOp>
+struct ReduceKernel {
+  /** The arguments at the start of the payload of the RUN_KERNEL message */
+  struct Args {
+    size_t id;           /**< the kernel id */
+    size_t size;         /**< the number of values in the vector */
+    size_t skipCount;    /**< the number of blocks folded in by the manager */
+    size_t zeroRunCount; /**< the number of runs of zero pages */
+  };
+
+  /** Offsets of the remaining parts of the payload */
+  static constexpr size_t ResultOffset = sizeof(Args);
+  static constexpr size_t ReduceOpOffset = ResultOffset + sizeof(R);
+  static constexpr size_t TransformOpOffset = ReduceOpOffset + sizeof(ReduceOp);
+  static constexpr size_t SkipOffset = TransformOpOffset + sizeof(TransformOp);
+
+  /**
+   * Reduce the vector described by \p msg.
+   * @param worker the CacheWorker holding the blocks on this process
+   * @param msg the RUN_KERNEL message
+   */
+  static void run(CacheWorker &worker, const MessagePtr &msg) {
+    const int rank = MPI_GET_RANK();
+    const size_t workers = MPI_GET_SIZE() - 1;
+    char *payload = msg->getPayload();
+    Args args;
+    std::memcpy(&args, payload, sizeof(Args));
+    alignas(ReduceOp) unsigned char reduceBytes[sizeof(ReduceOp)];
+    alignas(TransformOp) unsigned char transformBytes[sizeof(TransformOp)];
+    std::memcpy(reduceBytes, payload + ReduceOpOffset, sizeof(ReduceOp));
+    std::memcpy(transformBytes, payload + TransformOpOffset,
+                sizeof(TransformOp));
+    ReduceOp &reduceOp = *std::launder(reinterpret_cast<ReduceOp *>(reduceBytes));
+    TransformOp &transformOp =
+        *std::launder(reinterpret_cast<TransformOp *>(transformBytes));
+
+    std::optional<R> partial;
+    if (rank == 0) {
+      partial.emplace(load(payload + ResultOffset));
+    } else {
+      // the manager sorted the tags of the blocks it folded in, and the
+      // [begin, end) pairs of the runs of zero pages
+      std::vector<size_t> skip(args.skipCount);
+      std::vector<size_t> zeroRuns(2 * args.zeroRunCount);
+      std::memcpy(skip.data(), payload + SkipOffset,
+                  skip.size() * sizeof(size_t));
+      std::memcpy(zeroRuns.data(),
+                  payload + SkipOffset + skip.size() * sizeof(size_t),
+                  zeroRuns.size() * sizeof(size_t));
+      const size_t blocks =
+          (args.size + BlockElementCount - 1) / BlockElementCount;
+      auto run = zeroRuns.cbegin();
+      for (size_t tag = rank - 1; tag < blocks; tag += workers) {
+        if (detail::inZeroRun(zeroRuns, run, tag) ||
+            std::binary_search(skip.begin(), skip.end(), tag)) {
+          continue;
+        }
+        const T *values = reinterpret_cast<const T *>(
+            detail::findOwnedBlock(worker, msg->dsTag, tag)->getPayload());
+        const size_t count =
+            std::min<size_t>(BlockElementCount, args.size - tag * BlockElementCount);
+        fold(partial, values, count, reduceOp, transformOp);
+      }
+    }
+
+    if constexpr (MpiDatatype<R>::value && MpiOp<ReduceOp, R>::value) {
+      const R local = partial ? *partial : MpiOp<ReduceOp, R>::identity();
+      R result = local;
+      MPI_Reduce(&local, &result, 1, MpiDatatype<R>::get(),
+                 MpiOp<ReduceOp, R>::get(), 0, MPI_COMM_WORLD);
+      partial = result;
+    } else {
+      combine(partial, reduceOp);
+    }
+    if (rank == 0) {
+      std::memcpy(payload + ResultOffset, &*partial, sizeof(R));
+    }
+  }
+
+  /**
+   * Fold \p count values into a partial result.
+   * @param partial the partial result, which is empty until the first
+   * value is folded in
+   * @param values the values to be folded in
+   * @param count the number of values
+   * @param reduceOp the operation that combines results
+   * @param transformOp the operation applied to each value
+   */
+  static void fold(std::optional<R> &partial, const T *values, size_t count,
+                   ReduceOp &reduceOp, TransformOp &transformOp) {
+    if (count == 0) {
+      return;
+    }
+    size_t i = 0;
+    if (!partial) {
+      partial.emplace(transformOp(values[i++]));
+    }
+    for (R &result = *partial; i < count; i++) {
+      result = reduceOp(result, transformOp(values[i]));
+    }
+  }
+
+  /**
+   * Fold \p count copies of the same value into a partial result, by
+   * repeated doubling rather than one value at a time.
+   * @param partial the partial result, which is empty until the first
+   * value is folded in
+   * @param value the (transformed) value to be folded in
+   * @param count the number of copies of \p value
+   * @param reduceOp the operation that combines results
+   */
+  static void foldRepeated(std::optional<R> &partial, R value, size_t count,
+                           ReduceOp &reduceOp) {
+    for (; count > 0; count >>= 1) {
+      if (count & 1) {
+        partial = partial ? reduceOp(*partial, value) : value;
+      }
+      if (count > 1) {
+        value = reduceOp(value, value);
+      }
+    }
+  }
+
+  /**
+   * Obtain a result that was copied bytewise into a message.
+   * @param bytes the bytes of the result
+   * @return the result
+   */
+  static R load(const char *bytes) {
+    alignas(R) unsigned char storage[sizeof(R)];
+    std::memcpy(storage, bytes, sizeof(R));
+    return *std::launder(reinterpret_cast<R *>(storage));
+  }
+
+private:
+  /**
+   * Combine the partial results of all processes on the manager along a
+   * binomial tree: in round k, every process whose rank has bit k as its
+   * lowest set bit sends its partial result to the process 2^k below it
+   * and drops out. Processes without any values send an empty result.
+   * @param partial the partial result of this process, which is the
+   * combined result on the manager when this method returns
+   * @param reduceOp the operation that combines results
+   */
+  static void combine(std::optional<R> &partial, ReduceOp &reduceOp) {
+    const int rank = MPI_GET_RANK(), ranks = MPI_GET_SIZE();
+    char buffer[sizeof(R) + 1];
+    for (int step = 1; step < ranks; step <<= 1) {
+      if (rank & step) {
+        buffer[0] = partial.has_value();
+        if (partial) {
+          std::memcpy(buffer + 1, &*partial, sizeof(R));
+        }
+        MPI_Send(buffer, sizeof(buffer), MPI_BYTE, rank - step,
+                 Message::RUN_KERNEL, MPI_COMM_WORLD);
+        return;
+      }
+      if (rank + step < ranks) {
+        MPI_Recv(buffer, sizeof(buffer), MPI_BYTE, rank + step,
+                 Message::RUN_KERNEL, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (buffer[0]) {
+          const R other = load(buffer + 1);
+          partial = partial ? reduceOp(*partial, other) : other;
+        }
+      }
+    }
+  }
+};
+
+/**
+ * Apply \p transformOp to every value of \p vec and combine the results
+ * and \p init with \p reduceOp, in no particular order (as
+ * std::transform_reduce does). When the vector is larger than the
+ * manager cache, each worker reduces the blocks it owns and only the
+ * partial results are sent to the manager (see ReduceKernel); blocks
+ * modified on the manager are folded in there without being written
+ * back. Otherwise, or if the values, result or operations cannot be
+ * copied bytewise, the values are read a block at a time.
+ * @param vec the vector to be reduced
+ * @param init the initial value of the result
+ * @param reduceOp the associative and commutative binary operation that
+ * combines results, e.g., std::plus<>, pc2l::Min or pc2l::Max
+ * @param transformOp the unary operation applied to each value
+ * @return the combined result
+ */
+template <typename T, unsigned int UserBlockSize, unsigned int PrefetchCount,
+          PrefetchStrategy PFStrategy, typename R, typename ReduceOp,
+          typename TransformOp>
+R transform_reduce(Vector<T, UserBlockSize, PrefetchCount, PFStrategy> &vec,
+                   R init, ReduceOp reduceOp, TransformOp transformOp) {
+  using Vec = Vector<T, UserBlockSize, PrefetchCount, PFStrategy>;
+  using K = ReduceKernel<T, Vec::BlockElementCount, R, ReduceOp, TransformOp>;
+  if constexpr (std::is_trivially_copyable_v<R>) {
+    if (runOnWorkers<ReduceOp, TransformOp>(vec, 0, vec.size())) {
+      // fold in the blocks whose copies on the workers are stale
+      std::optional<R> partial(init);
+      const std::vector<size_t> skip = detail::visitDirtyBlocks(
+          vec, 0, vec.size(),
+          [&](size_t, const T *values, size_t begin, size_t end) {
+            K::fold(partial, values + begin, end - begin, reduceOp,
+                    transformOp);
+          });
+      // and the zero pages, which the workers do not have
+      std::vector<size_t> zeroRuns;
+      for (const auto &[begin, end] : vec.zeroRuns) {
+        const size_t count =
+            std::min<size_t>(end * Vec::BlockElementCount, vec.size()) -
+            begin * Vec::BlockElementCount;
+        K::foldRepeated(partial, transformOp(T{}), count, reduceOp);
+        zeroRuns.push_back(begin);
+        zeroRuns.push_back(end);
+      }
+
+      const typename K::Args args{RegisteredKernel<K>::id, vec.size(),
+                                  skip.size(), zeroRuns.size() / 2};
+      MessagePtr msg = Message::create(
+          K::SkipOffset + (skip.size() + zeroRuns.size()) * sizeof(size_t),
+          Message::RUN_KERNEL, 0, vec.dsTag, 0);
+      char *payload = msg->getPayload();
+      std::memcpy(payload, &args, sizeof(args));
+      std::memcpy(payload + K::ResultOffset, &*partial, sizeof(R));
+      std::memcpy(payload + K::ReduceOpOffset,
+                  static_cast<const void *>(&reduceOp), sizeof(ReduceOp));
+      std::memcpy(payload + K::TransformOpOffset,
+                  static_cast<const void *>(&transformOp), sizeof(TransformOp));
+      std::memcpy(payload + K::SkipOffset, skip.data(),
+                  skip.size() * sizeof(size_t));
+      std::memcpy(payload + K::SkipOffset + skip.size() * sizeof(size_t),
+                  zeroRuns.data(), zeroRuns.size() * sizeof(size_t));
+      System::get().cacheManager().launchKernel(msg);
+      return K::load(payload + K::ResultOffset);
+    }
+  }
+  std::as_const(vec).for_each_segment(
+      0, vec.size(), [&](const T *values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+          init = reduceOp(std::move(init), transformOp(values[i]));
+        }
+      });
+  return init;
+}
+
+/**
+ * Combine the values of \p vec and \p init with \p op, in no particular
+ * order (as std::reduce does). See pc2l::transform_reduce.
+ * @param vec the vector to be reduced
+ * @param init the initial value of the result
+ * @param op the associative and commutative binary operation that
+ * combines results, e.g., std::plus<>, pc2l::Min or pc2l::Max
+ * @return the combined result
+ */
+template <typename T, unsigned int UserBlockSize, unsigned int PrefetchCount,
+          PrefetchStrategy PFStrategy, typename R, typename BinaryOp = std::plus<>>
+R reduce(Vector<T, UserBlockSize, PrefetchCount, PFStrategy> &vec, R init,
+         BinaryOp op = BinaryOp()) {
+  return pc2l::transform_reduce(vec, init, op,
+                                [](const T &value) { return value; });
+}
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
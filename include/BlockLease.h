@@ -0,0 +1,159 @@
+#ifndef BLOCK_LEASE_H
+#define BLOCK_LEASE_H
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+/**
+ * @file BlockLease.h
+ * @brief Definition of a lease that pins a block in the manager cache
+ * @author JD Rudie
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+
+#include "Message.h"
+#include <new>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+/**
+ * A lease pins a block in the manager cache for as long as the lease
+ * is held. Eviction strategies skip pinned blocks, so the payload of a
+ * leased block stays the one and only copy of the block: it can be read
+ * and written directly, without refetching it, and writes are never
+ * lost to an eviction in the meantime. Leases are movable but not
+ * copyable; the block is unpinned when the lease is destroyed or
+ * released. Dropping or flushing the data structure of the block
+ * invalidates the lease: the block leaves the cache, the lease no
+ * longer pins anything, and writes through it are lost.
+ *
+ * \code
+ * auto row0 = vec.lease(0), row1 = vec.lease(rowLength);
+ * row1.values<double>()[0] += row0.values<double>()[0];
+ * \endcode
+ */
+class BlockLease {
+public:
+  /**
+   * Create an empty lease that does not pin any block.
+   */
+  BlockLease() noexcept = default;
+
+  /**
+   * Pin a block in the manager cache.
+   * \param[in] block the block to be pinned. The block must be in the
+   * manager cache.
+   * \exception Exception if pinning the block would exceed the
+   * number of bytes that may be pinned (see CacheManager::pinBlock)
+   */
+  explicit BlockLease(const MessagePtr &block);
+
+  /**
+   * Pin a block in the manager cache if the bytes that may be pinned
+   * allow it, and otherwise create an empty lease.
+   * \param[in] block the block to be pinned. The block must be in the
+   * manager cache.
+   */
+  BlockLease(const MessagePtr &block, std::nothrow_t) noexcept;
+
+  /**
+   * Take over the pin held by another lease.
+   * \param[in,out] other the lease whose pin is taken over. It is left
+   * empty.
+   */
+  BlockLease(BlockLease &&other) noexcept;
+
+  /**
+   * Release the pin held by this lease and take over the pin held by
+   * another lease.
+   * \param[in,out] other the lease whose pin is taken over. It is left
+   * empty.
+   * \return this lease
+   */
+  BlockLease &operator=(BlockLease &&other) noexcept;
+
+  BlockLease(const BlockLease &) = delete;
+  BlockLease &operator=(const BlockLease &) = delete;
+
+  /**
+   * The destructor releases the pin held by this lease (if any).
+   */
+  ~BlockLease() { release(); }
+
+  /**
+   * Unpin the leased block (if any) and leave this lease empty.
+   */
+  void release() noexcept;
+
+  /**
+   * Check whether this lease pins a block.
+   * \return true if a block is pinned by this lease
+   */
+  explicit operator bool() const noexcept { return block != nullptr; }
+
+  /**
+   * Obtain the leased block.
+   * \return the leased block, or nullptr if this lease is empty
+   */
+  const MessagePtr &get() const noexcept { return block; }
+
+  /**
+   * Access the header of the leased block.
+   */
+  Message *operator->() const noexcept { return block.get(); }
+
+  /**
+   * Obtain the values stored in the payload of the leased block. The
+   * block is marked dirty, since the values may be written through the
+   * returned pointer.
+   * \tparam T the type of the values stored in the block
+   * \return pointer to the first value of the block
+   */
+  template <typename T> T *values() const noexcept {
+    block->dirty = true;
+    return reinterpret_cast<T *>(block->getPayload());
+  }
+
+private:
+  /** The leased block, or nullptr if this lease is empty */
+  MessagePtr block;
+};
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
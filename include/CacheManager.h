@@ -41,7 +41,13 @@
 #include "LeastRecentlyUsedCacheWorker.h"
 #include "MostRecentlyUsedCacheWorker.h"
 #include "PseudoLRUCacheWorker.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 /**
  * @file CacheManager.h
@@ -77,18 +83,31 @@ public:
    * The polymorphic destructor.  The destructor does not have much
    * to do but is present for future extensions (if any).
    */
-  virtual ~CacheManager() {}
+  virtual ~CacheManager() { stopProgressThread(); }
 
   /**
    * The manager does not have a specific task in the run method.
    * The operations of a manager are triggered by data structures to
-   * access information in the manager. However, in order to utilize the
-   * memory of the manager as well, we run a typical
-   * CacheWorker thread in the background on the manager node.
-   *
+   * access information in the manager. If useProgressThread is set,
+   * this method starts a thread that keeps the prefetches and
+   * write-backs in flight progressing while the application computes
+   * (i.e., while it is not inside the manager). MPI is called by one
+   * thread at a time, so this requires MPI_THREAD_SERIALIZED; with a
+   * lower thread level, no thread is started.
    */
   void run() override;
 
+  /**
+   * Whether run starts the progress thread.
+   */
+  bool useProgressThread = false;
+
+  /**
+   * The initialize method notes that the workers are running so that
+   * data structures can ask them to release blocks.
+   */
+  void initialize() override;
+
   /**
    * The finalize method sends finish messages to all of the workers
    * to let them know they need to wind-up their operation.
@@ -110,21 +129,414 @@ public:
    * remote CacheWorker
    * \param[in] dsTag the data structure tag associated with this block
    * \param[in] blockTag the block tag associated with this block
-   * \return message containing block requested
+   * \return message containing block requested, or nullptr if the block
+   * does not exist
    */
   MessagePtr getBlockFallbackRemote(size_t dsTag, size_t blockTag);
 
   /**
-   *  Retrieve a block from a remote CacheWorker in a non-blocking fashion
+   * Check whether a block exists, either in the manager cache or on its
+   * remote CacheWorker, without transferring the block.
+   * \param[in] dsTag the data structure tag associated with this block
+   * \param[in] blockTag the block tag associated with this block
+   * \return true if the block exists
+   */
+  bool probeBlock(size_t dsTag, size_t blockTag);
+
+  /**
+   * Apply a registered update to one value of a block. If the block is
+   * in the manager cache, the cached copy is updated (and marked dirty).
+   * Otherwise the UPDATE_ELEMENT message is sent to the worker that owns
+   * the block, which applies the update to its copy, so that only the
+   * operand and the old value cross the network.
+   * \param[in] msg the UPDATE_ELEMENT message for the block, with an
+   * UpdateHeader followed by the operand of the update
+   * \param[out] old receives the value before the update
+   * \exception Exception if the block does not exist
+   */
+  void updateBlock(const MessagePtr &msg, char *old);
+
+  /**
+   * Retrieve a batch of blocks belonging to the same data structure.
+   * Blocks that are in the manager cache are returned directly. For
+   * the remaining blocks, every request is sent to the owning workers
+   * before any reply is awaited, so that the workers serve them
+   * concurrently instead of one round trip at a time. Fetched blocks
+   * are placed into the manager cache.
+   * \param[in] dsTag the data structure tag associated with the blocks
+   * \param[in] blockTags the block tags of the blocks to retrieve
+   * \return messages containing the blocks, in the order of \p blockTags
+   * (nullptr for blocks that do not exist)
+   */
+  std::vector<MessagePtr>
+  getBlocksFallbackRemote(size_t dsTag, const std::vector<size_t> &blockTags);
+
+  /**
+   * Start fetching a block from its remote CacheWorker without waiting
+   * for it. The reply is received into a buffer of its own and the
+   * block is placed into the manager cache once it has arrived (see
+   * progressPrefetches). Up to PrefetchSlots blocks can be in flight at
+   * a time; when all slots are taken the request is dropped. Nothing
+   * is done if the block is cached or in flight already, or if the
+   * workers are not running.
    * \param[in] dsTag the data structure tag associated with this block
    * \param[in] blockTag the block tag associated with this block
-   *
+   * \param[in] blockSize the size of the block message (header and
+   * payload) in bytes
+   * \return true if the block is cached or in flight when this method
+   * returns
+   */
+  bool prefetchBlock(size_t dsTag, size_t blockTag, int blockSize);
+
+  /**
+   * Place every prefetched block that has arrived (as reported by
+   * MPI_Testsome) into the manager cache, without waiting for the
+   * others.
    */
-  void getRemoteBlockNonblocking(size_t dsTag, size_t blockTag);
+  void progressPrefetches();
+
+  /**
+   * Wait for every prefetched block to arrive and place them into the
+   * manager cache. This is needed before messages from the workers
+   * other than block replies are expected, and before blocks of a data
+   * structure are erased.
+   */
+  void drainPrefetches();
+
+  /**
+   * The maximum number of prefetched blocks that can be in flight
+   */
+  static constexpr int PrefetchSlots = 16;
+
+  /**
+   * The number of evicted blocks that are held back for a worker before
+   * they are sent to it in a single STORE_BLOCKS message
+   */
+  static constexpr size_t StoreBatchSize = 16;
+
+  /**
+   * The maximum number of bytes held by evicted blocks that have not
+   * been written back yet (i.e., that are held back or whose sends are
+   * in flight). When it is exceeded, eviction waits for sends to
+   * complete. Zero means the cache size.
+   */
+  unsigned long long writeBackLimit = 0;
+
+  /**
+   * Obtain the number of bytes held by evicted blocks that have not been
+   * written back yet.
+   * \return the number of bytes
+   */
+  unsigned long long getWriteBackBytes() const noexcept {
+    return writeBackBytes;
+  }
+
+  /**
+   * Complete the sends of evicted blocks that have finished and release
+   * their buffers, without waiting for any.
+   */
+  void progressWriteBacks();
+
+  /**
+   * Send a message to a worker. Evicted blocks that are held back for
+   * the worker are sent first, since the message may refer to them.
+   * Requests for blocks only wait for the blocks held back if they ask
+   * for one of them.
+   * \param[in] msgPtr the message to be sent
+   * \param[in] destRank the rank of the worker
+   */
+  void send(MessagePtr msgPtr, const int destRank = 0) override;
+
+  /**
+   * Release every block of a data structure. The blocks are erased from
+   * the manager cache and, while the workers are running, a DROP_DS
+   * message asks every worker to erase its blocks as well. Since
+   * messages between a pair of processes are not overtaken, blocks
+   * evicted to a worker earlier are erased along with the rest.
+   * \param[in] dsTag the data structure tag associated with the blocks
+   */
+  void dropDataStructure(size_t dsTag);
+
+  /**
+   * Write every dirty cached block of a data structure back to its
+   * owning worker and erase all of its blocks from the manager cache.
+   * Afterwards the workers hold the only (and current) copy of each
+   * block, which is what kernels that work on the blocks in place
+   * expect.
+   * \param[in] dsTag the data structure tag associated with the blocks
+   * \param[in] blockCount the number of blocks in the data structure
+   */
+  void flushDataStructure(size_t dsTag, size_t blockCount);
+
+  /**
+   * Collect the blocks of a data structure that are cached on the
+   * manager and have been modified since they were last written back,
+   * i.e., whose copy on the owning worker is stale.
+   * \param[in] dsTag the data structure tag associated with the blocks
+   * \return the dirty blocks, in no particular order
+   */
+  std::vector<MessagePtr> getDirtyBlocks(size_t dsTag);
+
+  /**
+   * Run a kernel on every process. The RUN_KERNEL message is sent to
+   * each worker and the kernel is then run on the manager too, so that
+   * it can coordinate any collective operations the kernel performs.
+   * \param[in] msg The RUN_KERNEL message with the kernel id followed by
+   * any arguments for the kernel.
+   */
+  void launchKernel(const MessagePtr &msg);
+
+  /**
+   * Pin a block in the manager cache, so that the eviction strategy
+   * skips it until it is unpinned. Pins are counted, so a block can be
+   * pinned more than once. To keep room in the cache for other blocks,
+   * at most half of the cache can be pinned at any time. Use a
+   * BlockLease rather than calling this method directly.
+   * \param[in] block the block to be pinned
+   * \exception Exception if pinning the block would exceed the number
+   * of bytes that may be pinned
+   */
+  void pinBlock(const MessagePtr &block);
+
+  /**
+   * Pin a block in the manager cache as pinBlock does, unless that
+   * would exceed the number of bytes that may be pinned.
+   * \param[in] block the block to be pinned
+   * \return true if the block was pinned
+   */
+  bool tryPinBlock(const MessagePtr &block) noexcept;
+
+  /**
+   * Undo one pinBlock call for a block. The block can be evicted once
+   * all of its pins are undone.
+   * \param[in] block the block to be unpinned
+   */
+  void unpinBlock(const MessagePtr &block) noexcept;
+
+  /**
+   * Obtain the number of bytes in blocks that are currently pinned.
+   * \return the number of pinned bytes
+   */
+  unsigned long long getPinnedBytes() const noexcept { return pinnedBytes; }
+
+  /**
+   * Check whether the workers are processing messages, i.e., whether
+   * this is the manager process between initialize and finalize.
+   * \return true if messages can be sent to the workers
+   */
+  bool workersRunning() const noexcept { return running; }
+
+protected:
+  /**
+   * Hold a dirty block evicted from the manager cache back until
+   * StoreBatchSize blocks have been evicted for the same worker (or a
+   * message that may refer to them is sent to it), so that the worker
+   * receives them in a single STORE_BLOCKS message. The message is sent
+   * without waiting for it to be received, so a cache miss does not pay
+   * for writing back its victim; only when the blocks being written
+   * back hold more than writeBackLimit bytes does eviction wait.
+   * \param[in] block the block to be written back
+   */
+  void writeBackBlock(const MessagePtr &block) override;
 
 private:
-  MPI_Request prefetchReq;
-  MessagePtr prefetchMsg;
+  /**
+   * A message with evicted blocks whose (nonblocking) send is in flight
+   */
+  struct WriteBack {
+    MessagePtr msg;                  /**< the message being sent */
+    std::vector<MessagePtr> blocks;  /**< the blocks in the message */
+  };
+
+  /**
+   * Start sending the evicted blocks held back for a worker, if any.
+   * \param[in] rank the rank of the worker
+   */
+  void sendPendingStores(int rank);
+
+  /**
+   * Complete sends of evicted blocks and release their buffers.
+   * \param[in] wait if true, wait for sends until the blocks being
+   * written back fit into writeBackLimit (or none is left), otherwise
+   * only complete the sends that have finished
+   */
+  void retireWriteBacks(bool wait);
+
+  /**
+   * Stop treating the blocks of a data structure that are being written
+   * back as part of the write-back buffer. Their sends still complete,
+   * but the blocks are no longer reinstated or counted against
+   * writeBackLimit.
+   * \param[in] dsTag the data structure tag whose blocks are dropped
+   */
+  void forgetWriteBacks(size_t dsTag);
+
+  /**
+   * Undo all pins on the cached blocks of a data structure that is
+   * dropped or flushed, so that the leases on them no longer count
+   * towards the bytes that may be pinned.
+   * \param[in] dsTag the tag of the data structure
+   */
+  void invalidatePins(size_t dsTag);
+
+  /**
+   * Place a block that has been evicted but not written back yet into
+   * the manager cache again. Its data is taken from the write-back
+   * rather than requested from the worker, and it is clean, since the
+   * write-back brings the worker's copy up to date.
+   * \param[in] dsTag the data structure tag associated with the block
+   * \param[in] blockTag the block tag associated with the block
+   * \return the cached block, or nullptr if the block is not being
+   * written back
+   */
+  MessagePtr reinstateWriteBack(size_t dsTag, size_t blockTag);
+
+  /**
+   * The evicted blocks that are held back for each worker (by rank)
+   */
+  std::unordered_map<int, std::vector<MessagePtr>> pendingStores;
+
+  /**
+   * The requests of the sends of evicted blocks in flight, in the order
+   * they were started, along with the matching writeBacks
+   */
+  std::vector<MPI_Request> writeBackReqs;
+
+  /**
+   * The sends of evicted blocks in flight, matching writeBackReqs
+   */
+  std::vector<WriteBack> writeBacks;
+
+  /**
+   * The number of bytes held by evicted blocks that are held back or in
+   * flight. Atomic, since the progress thread retires write-backs
+   * while the application may be reading it.
+   */
+  std::atomic<unsigned long long> writeBackBytes{0};
+
+  /**
+   * Flag to indicate that the workers are processing messages, i.e.,
+   * this is the manager process between initialize and finalize.
+   */
+  bool running = false;
+
+  /**
+   * The number of bytes in blocks that are pinned by at least one lease
+   */
+  unsigned long long pinnedBytes = 0;
+
+  /**
+   * How long the progress thread sleeps between two rounds of driving
+   * the requests in flight.
+   */
+  static constexpr std::chrono::microseconds ProgressInterval{50};
+
+  /**
+   * Serialize the MPI calls of the calling thread with the progress
+   * thread's, if it is running. Every method of the manager that calls
+   * MPI (directly or via Worker) while the thread may run takes this
+   * lock first; the data structures and algorithms reach MPI only
+   * through these methods (kernels via launchKernel).
+   * \return a lock on mpiLock, or an empty lock if there is no
+   * progress thread
+   */
+  std::unique_lock<std::recursive_mutex> lockMpi() {
+    return progressThread.joinable()
+               ? std::unique_lock<std::recursive_mutex>(mpiLock)
+               : std::unique_lock<std::recursive_mutex>();
+  }
+
+  /**
+   * The loop of the progress thread. Whenever the application is not
+   * using MPI, it checks the prefetches in flight via
+   * MPI_Request_get_status, which lets MPI move them along without
+   * completing them (they are installed into the cache by the
+   * application thread), and retires the write-backs that have
+   * finished. While neither is in flight, it sleeps until woken by
+   * wakeProgress.
+   */
+  void progress();
+
+  /**
+   * Wake the progress thread, if it is waiting for requests to be
+   * started. Called with mpiLock held.
+   */
+  void wakeProgress();
+
+  /**
+   * Stop the progress thread, if it is running, and wait for it.
+   */
+  void stopProgressThread() noexcept;
+
+  /**
+   * The progress thread, if any
+   */
+  std::thread progressThread;
+
+  /**
+   * Tells the progress thread to stop
+   */
+  std::atomic<bool> stopProgress{false};
+
+  /**
+   * Guards progressWork, which the idle progress thread waits on
+   */
+  std::mutex progressLock;
+
+  /**
+   * Signalled when requests are started or the progress thread is to
+   * stop
+   */
+  std::condition_variable progressReady;
+
+  /**
+   * Set when requests were started since the progress thread last
+   * found nothing in flight
+   */
+  bool progressWork = false;
+
+  /**
+   * Held by the thread that calls MPI while the progress thread runs.
+   * Recursive, since the methods that take it call each other.
+   */
+  std::recursive_mutex mpiLock;
+
+  /**
+   * Wait for the prefetch in a given slot to complete and place the
+   * block into the manager cache. The slot is free afterwards.
+   * \param[in] slot the slot of the prefetch
+   */
+  void completePrefetch(int slot);
+
+  /**
+   * Place the block received by a completed prefetch into the manager
+   * cache and free its slot.
+   * \param[in] slot the slot of the completed prefetch
+   */
+  void installPrefetch(int slot);
+
+  /**
+   * The receive requests of the prefetches, indexed by slot. Free slots
+   * hold MPI_REQUEST_NULL, which MPI_Testsome skips.
+   */
+  std::vector<MPI_Request> prefetchReqs =
+      std::vector<MPI_Request>(PrefetchSlots, MPI_REQUEST_NULL);
+
+  /**
+   * The receive buffers of the prefetches, indexed by slot
+   */
+  std::vector<std::vector<char>> prefetchBufs =
+      std::vector<std::vector<char>>(PrefetchSlots);
+
+  /**
+   * The slot of every block (by key) that is in flight
+   */
+  std::unordered_map<size_t, int> inFlight;
+
+  /**
+   * Buffer for the slots completed by MPI_Testsome
+   */
+  std::vector<int> completedSlots = std::vector<int>(PrefetchSlots);
 };
 
 /**
@@ -48,9 +48,12 @@
 #include "Exception.h"
 #include "Utilities.h"
 #include "Worker.h"
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <list>
 #include <unordered_map>
+#include <vector>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
@@ -89,14 +92,53 @@ public:
    */
   virtual ~CacheWorker() {}
 
+  /** The number of receives posted ahead for messages from the manager */
+  static constexpr int ControlSlots = 16;
+
+  /** The number of receives posted ahead for the second part of larger
+      messages from the manager (see Worker::RingTag) */
+  static constexpr int BlockSlots = 8;
+
   /**
    * This is the primary method of a worker.  This method overrides
    * the implementation in the derived class.  This method keeps
    * running (processing messages) until the manager process sends a
    * message to stop the worker.
+   *
+   * Receives for the messages from the manager are posted ahead of
+   * time, in rings of ControlSlots and BlockSlots buffers, so that the
+   * next requests arrive while one is served and each is matched only
+   * once. Replies are sent without waiting for them to be received.
+   *
+   * If the cache is split into several shards (see getShardCount),
+   * requests for single blocks are served by one executor thread per
+   * shard, while the calling thread keeps receiving requests and
+   * sending replies (in the order of the requests). Requests that
+   * involve several blocks are served by the calling thread once the
+   * executors are idle.
    */
   virtual void run() override;
 
+  /**
+   * Serve a single message from the manager, i.e., dispatch it to the
+   * method that handles its tag (other than FINISH).
+   *
+   * \param[in] msg The message to be served.
+   */
+  void serve(const MessagePtr &msg);
+
+  /**
+   * Start sending a message (e.g., a reply to the manager) without
+   * waiting for it to be received. The message is kept until the send
+   * completes.
+   *
+   * \param[in] msgPtr Pointer to the message to be sent.
+   *
+   * \param[in] destRank The destination rank to where the message
+   * is to be sent.
+   */
+  virtual void send(MessagePtr msgPtr, const int destRank = 0) override;
+
   /**
    * Method that computes hash and stores a block of cache data from
    * a given message.
@@ -115,21 +157,106 @@ public:
    */
   void eraseCacheBlock(const MessagePtr &msg);
 
+  /**
+   * Method that erases every block of cache data that belongs to the
+   * data structure of a given message.
+   *
+   * \param[in] msg The message whose dsTag identifies the data
+   * structure whose blocks need to be erased.
+   */
+  void eraseDataStructure(const MessagePtr &msg);
+
   /**
    * Method that computes hash and sends the requested block of
-   * cache data to the process that requested the block.
+   * cache data to the process that requested the block. If the block
+   * is not in the cache, a BLOCK_NOT_FOUND message (without payload) is
+   * sent instead, so that the requestor is never left waiting.
    *
    * \param[in] msg The message that contains information about the
    * block of cache requested by the sender of the message.
    */
   void sendCacheBlock(const MessagePtr &msg);
 
+  /**
+   * Tell the sender of a PROBE_BLOCK message whether the block exists,
+   * without sending the block itself. The reply (without payload) is a
+   * PROBE_BLOCK message if the block is in the cache and a
+   * BLOCK_NOT_FOUND message otherwise.
+   *
+   * \param[in] msg The PROBE_BLOCK message naming the block.
+   */
+  void probeCacheBlock(const MessagePtr &msg);
+
+  /**
+   * Method that serves a GET_BLOCKS message, whose payload holds the
+   * keys of several blocks. The blocks are sent back in the order of
+   * the keys, with a BLOCK_NOT_FOUND message (without payload) in place
+   * of each block that is not in the cache. They are sent in a single
+   * STORE_BLOCKS message unless they add up to more than
+   * Message::MaxBatchSize bytes, in which case they are split into
+   * several messages (see Message::splitBatches), where a group of one
+   * block is sent as is.
+   *
+   * \param[in] msg The GET_BLOCKS message with the keys of the blocks.
+   */
+  void sendCacheBlocks(const MessagePtr &msg);
+
+  /**
+   * Method that applies the update described by an UPDATE_ELEMENT
+   * message to one value of a cached block and sends the value it held
+   * before the update back to the sender. If the block is not in the
+   * cache, a BLOCK_NOT_FOUND message is sent back instead.
+   *
+   * \param[in] msg The UPDATE_ELEMENT message with an UpdateHeader
+   * followed by the operand of the update.
+   */
+  void updateCacheBlock(const MessagePtr &msg);
+
+  /**
+   * Apply the update described by the payload of an UPDATE_ELEMENT
+   * message to one value of a block.
+   *
+   * \param[in] block the block holding the value
+   * \param[in] update the payload of the UPDATE_ELEMENT message
+   * \param[out] old receives the value before the update
+   * \exception Exception if the update is not registered
+   */
+  static void applyUpdate(const MessagePtr &block, const char *update,
+                          char *old);
+
+  /**
+   * Method that runs the kernel (see Kernel.h) whose id is at the start
+   * of the payload of a given message.
+   *
+   * \param[in] msg The RUN_KERNEL message with the kernel id followed by
+   * any arguments for the kernel.
+   */
+  void runKernel(const MessagePtr &msg);
+
+  /**
+   * Look up a block in the cache without referring it to the eviction
+   * scheme. Kernels use this to work on the blocks held by a process.
+   * \param[in] dsTag the data structure tag associated with the block
+   * \param[in] blockTag the block tag associated with the block
+   * \return the cached block, or nullptr if it is not in the cache
+   */
+  MessagePtr findCacheBlock(size_t dsTag, size_t blockTag);
+
   /**
    * Refer the key for a block to our eviction scheme
    * @param key the key to place into eviction scheme
    */
   virtual void refer(const MessagePtr &msg) = 0;
 
+  /**
+   * Compute the rank of the worker process that owns (i.e., stores
+   * when it is not cached on the manager) a given block. Blocks are
+   * distributed round-robin across the worker processes.
+   * \param[in] blockTag the block tag associated with the block
+   * \return the MPI rank of the worker that stores the block
+   */
+  static int getStoredRank(size_t blockTag);
+
 protected:
   /**
    * Add an item to the cache data structure. This is a pure
@@ -157,6 +284,53 @@ protected:
    */
   virtual void eraseFromCache(size_t key) = 0;
 
+  /**
+   * Erase every block of a given data structure from the cache,
+   * including any bookkeeping the eviction strategy keeps for them.
+   * @param dsTag the data structure tag of the blocks to erase
+   * @return the number of bytes held by the erased blocks
+   */
+  virtual size_t eraseDsFromCache(size_t dsTag) = 0;
+
+  /**
+   * Collect every block of a given data structure that is in the cache,
+   * without referring them to the eviction strategy.
+   * @param dsTag the data structure tag of the blocks to collect
+   * @return the cached blocks, in no particular order
+   */
+  virtual std::vector<MessagePtr> getDsFromCache(size_t dsTag) = 0;
+
+  /**
+   * Erase a block chosen for eviction from the cache. If the block is
+   * dirty it is sent to the worker that owns it, otherwise the copy
+   * held by that worker is still current and the block is just dropped.
+   * \param[in] evicted the block to be evicted
+   */
+  void evictCacheBlock(const MessagePtr &evicted);
+
+  /**
+   * Send a dirty block that is no longer cached to the worker that owns
+   * it. The base class method sends it right away.
+   * \param[in] block the block to be written back
+   */
+  virtual void writeBackBlock(const MessagePtr &block);
+
+  /**
+   * Obtain the number of shards the cache is split into. Blocks in
+   * different shards may be stored, looked up and erased concurrently
+   * (but blocks of the same shard may not). The base class method
+   * returns 1, i.e., the cache must be used by one thread at a time.
+   * \return the number of shards
+   */
+  virtual size_t getShardCount() const noexcept { return 1; }
+
+  /**
+   * Obtain the shard that holds a given block.
+   * \param[in] key the key of the block
+   * \return the shard, which is less than getShardCount()
+   */
+  virtual size_t getShard(size_t /* key */) const noexcept { return 0; }
+
   /**
    * If in profiling mode: keep a counter for cache hits
    */
@@ -168,9 +342,10 @@ protected:
   PC2L_PROFILE(size_t accesses = 0;)
   /**
    * The amount of bytes currently stored in the cache manager (incremented
-   * each time a message is added
+   * each time a message is added). Shards of a worker's cache may be
+   * changed concurrently, hence the atomic.
    */
-  unsigned int currentBytes = 0;
+  std::atomic<unsigned int> currentBytes{0};
   /**
    * This is a convenience message that is created in the
    * constructor.  This is used to quickly send a "block-not-found"
@@ -178,6 +353,151 @@ protected:
    * This message is reused to minimize message creation overheads.
    */
   MessagePtr blockNotFoundMsg;
+
+private:
+  /**
+   * A ring of receives for messages from the manager with a given MPI
+   * tag, each into a buffer from MessagePool. Since MPI matches
+   * messages from the same sender to receives in the order in which
+   * the receives were posted, messages are taken from the ring in the
+   * order in which they were sent. A receive is posted again as soon
+   * as its message has been taken. Messages that fill at most half of
+   * a buffer are copied into a buffer of their own size, so that the
+   * buffer of the receive can be posted again, rather than cached
+   * along with the message.
+   *
+   * The ring for CONTROL_TAG also looks at the headers of messages
+   * larger than BlockSlotSize (see Worker::startSend) as soon as they
+   * arrive, in the order they were sent, and posts a receive of the
+   * exact size for the rest of each message.
+   */
+  class ReceiveRing {
+  public:
+    /**
+     * Post the receives of a ring.
+     * \param[in] slots the number of receives kept posted
+     * \param[in] slotSize the size of the buffer of each receive
+     * \param[in] tag the MPI tag of the messages to receive
+     * \param[in] postLarge if true, post the receives of messages sent
+     * with LARGE_TAG whose headers arrive in this ring
+     */
+    ReceiveRing(int slots, int slotSize, int tag, bool postLarge = false);
+
+    /**
+     * Cancel the receives that are still posted and release their
+     * buffers.
+     */
+    ~ReceiveRing();
+
+    /**
+     * Check, without waiting, whether the next message has arrived.
+     * \return true if take would return without waiting
+     */
+    bool ready();
+
+    /**
+     * Wait for the next message, i.e., the message received by the
+     * oldest receive.
+     * \param[out] sentSize the size of the message given in its
+     * header, which exceeds the size received if only the header was
+     * sent with this ring's tag
+     * \return the message, which owns the buffer it was received into
+     */
+    MessagePtr take(int &sentSize);
+
+    /**
+     * Wait for the oldest message sent with LARGE_TAG, i.e., the rest
+     * of the message whose header take returned last.
+     * \return the message, which owns the buffer it was received into
+     */
+    MessagePtr takeLarge();
+
+  private:
+    /** Post the receive of a slot into its buffer */
+    void post(size_t slot);
+
+    /**
+     * Note the sizes of the receives that completed, and post the
+     * receives of large messages whose headers arrived (see postLarge).
+     * \param[in] count the number of completed receives
+     */
+    void completed(int count);
+
+    /** A receive of a message sent with LARGE_TAG */
+    struct Large {
+      MPI_Request req; /**< the posted receive */
+      char *buffer;    /**< the buffer it receives into */
+      int size;        /**< the size of the message */
+    };
+
+    /** The size of the buffer of each receive */
+    const int slotSize;
+    /** The MPI tag of the messages to receive */
+    const int tag;
+    /** Whether to post the receives of large messages */
+    const bool postLarge;
+    /** The slot whose message is taken next */
+    size_t head = 0;
+    /** The number of slots from head whose headers have been examined */
+    size_t examined = 0;
+    /** The posted receives, MPI_REQUEST_NULL once completed */
+    std::vector<MPI_Request> reqs;
+    /** The buffer of each receive */
+    std::vector<char *> buffers;
+    /** The number of bytes received by each slot (-1 if pending) */
+    std::vector<int> received;
+    /** Scratch space for MPI_Waitsome */
+    std::vector<int> indices;
+    /** Scratch space for MPI_Waitsome */
+    std::vector<MPI_Status> statuses;
+    /** The receives of large messages, in the order they were sent */
+    std::deque<Large> large;
+  };
+
+  /**
+   * Threads that each serve the requests for the blocks of one shard of
+   * the cache (see getShardCount), in the order they were dispatched.
+   * Defined in CacheWorker.cpp.
+   */
+  class Executors;
+
+  /**
+   * Wait for the next message from the manager, including the second
+   * part of a message whose header came on its own.
+   * \param[in] control the ring for CONTROL_TAG messages
+   * \param[in] blocks the ring for BLOCK_TAG messages
+   * \return the message
+   */
+  MessagePtr nextMessage(ReceiveRing &control, ReceiveRing &blocks);
+
+  /**
+   * The loop of run when the cache is split into several shards: the
+   * calling thread receives requests and sends replies, and the
+   * requests for single blocks are served by executors.
+   * \param[in] control the ring for CONTROL_TAG messages
+   * \param[in] blocks the ring for BLOCK_TAG messages
+   */
+  void runSharded(ReceiveRing &control, ReceiveRing &blocks);
+
+  /**
+   * The executors serving requests while runSharded runs, nullptr
+   * otherwise. Replies sent by executors are handed to them, so that
+   * only the thread running run uses MPI.
+   */
+  Executors *executors = nullptr;
+
+  /**
+   * Complete the sends started via send.
+   * \param[in] wait if true, wait for all of them, otherwise only
+   * complete the ones that have finished
+   */
+  void completeReplies(bool wait);
+
+  /** The sends started via send that may not have completed yet */
+  std::vector<MPI_Request> replyReqs;
+
+  /** The message of each request in replyReqs */
+  std::vector<MessagePtr> replies;
 };
 
 END_NAMESPACE(pc2l);
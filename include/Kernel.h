@@ -0,0 +1,161 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+/**
+ * @file Kernel.h
+ * @brief Definition of the registry of kernels that can be run on workers
+ * @author JD Rudie
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+
+#include "CacheWorker.h"
+#include <string>
+#include <typeinfo>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+/**
+ * A function that is run on every process in response to a RUN_KERNEL
+ * message. The kernel is given the CacheWorker of the process (so that it
+ * can work on the blocks held by that process) and the RUN_KERNEL message
+ * (whose payload starts with the kernel id, followed by any arguments).
+ */
+using Kernel = void (*)(CacheWorker &worker, const MessagePtr &msg);
+
+/**
+ * The process-wide registry of kernels. Every process runs the same
+ * executable, so kernels registered during static initialization get
+ * the same id on every process, which lets the manager refer to a
+ * kernel by id in a message.
+ */
+class KernelRegistry {
+public:
+  /**
+   * Register a kernel under an id computed from a given name.
+   * Registering the same kernel again is harmless.
+   * \param[in] name a name that is unique to the kernel
+   * \param[in] kernel the kernel to be registered
+   * \return the id of the kernel
+   * \exception Exception if a different kernel has the same id
+   */
+  static size_t add(const std::string &name, Kernel kernel);
+
+  /**
+   * Look up the kernel registered under a given id.
+   * \param[in] id the id of the kernel
+   * \return the kernel, or nullptr if no kernel has the given id
+   */
+  static Kernel find(size_t id);
+};
+
+/**
+ * Registers the static K::run method as a kernel. Referring to
+ * RegisteredKernel<K>::id instantiates the registration, which is then
+ * performed on every process during static initialization.
+ */
+template <typename K> struct RegisteredKernel {
+  /** The id of the kernel, for use in RUN_KERNEL messages */
+  static const size_t id;
+};
+
+template <typename K>
+const size_t RegisteredKernel<K>::id =
+    KernelRegistry::add(typeid(K).name(), &K::run);
+
+/**
+ * A function that changes a single value of a block in place in response
+ * to an UPDATE_ELEMENT message. The update is given the bytes of the
+ * value and the bytes of the operand sent with the message.
+ */
+using Update = void (*)(char *value, const char *operand);
+
+/**
+ * The start of the payload of an UPDATE_ELEMENT message. The operand of
+ * the update follows it.
+ */
+struct UpdateHeader {
+  size_t id;     /**< the id of the update */
+  size_t offset; /**< the offset of the value in the block (in bytes) */
+  size_t size;   /**< the size of the value (in bytes) */
+};
+
+/**
+ * The process-wide registry of updates, which works the same way as the
+ * KernelRegistry.
+ */
+class UpdateRegistry {
+public:
+  /**
+   * Register an update under an id computed from a given name.
+   * Registering the same update again is harmless.
+   * \param[in] name a name that is unique to the update
+   * \param[in] update the update to be registered
+   * \return the id of the update
+   * \exception Exception if a different update has the same id
+   */
+  static size_t add(const std::string &name, Update update);
+
+  /**
+   * Look up the update registered under a given id.
+   * \param[in] id the id of the update
+   * \return the update, or nullptr if no update has the given id
+   */
+  static Update find(size_t id);
+};
+
+/**
+ * Registers the static U::apply method as an update. Referring to
+ * RegisteredUpdate<U>::id instantiates the registration, which is then
+ * performed on every process during static initialization.
+ */
+template <typename U> struct RegisteredUpdate {
+  /** The id of the update, for use in UPDATE_ELEMENT messages */
+  static const size_t id;
+};
+
+template <typename U>
+const size_t RegisteredUpdate<U>::id =
+    UpdateRegistry::add(typeid(U).name(), &U::apply);
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
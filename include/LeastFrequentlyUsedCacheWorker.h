@@ -67,6 +67,10 @@ protected:
 
   void eraseFromCache(size_t key) override;
 
+  size_t eraseDsFromCache(size_t dsTag) override;
+
+  std::vector<MessagePtr> getDsFromCache(size_t dsTag) override;
+
   MessagePtr &getFromCache(size_t key) override;
 
 private:
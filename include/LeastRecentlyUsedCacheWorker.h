@@ -67,6 +67,10 @@ protected:
 
   void eraseFromCache(size_t key) override;
 
+  size_t eraseDsFromCache(size_t dsTag) override;
+
+  std::vector<MessagePtr> getDsFromCache(size_t dsTag) override;
+
   /**
    * Keys of blocks in queue in their removal order under LRU
    * Note that we use  a std::list here for both complexity (O(1) insertion and
@@ -79,7 +79,25 @@ public:
     virtual ValueType &val() { return second; }
   };
 
-  typedef typename pc2l::Vector<MapPair>::Iterator iterator;
+  /**
+   * Iterator over the pairs in the map. Unlike the iterator of the
+   * underlying vector, dereferencing yields a MapPair& rather than a
+   * Vector::Reference, so that members such as first can be used
+   * directly.
+   */
+  class iterator : public pc2l::Vector<MapPair>::Iterator {
+  public:
+    using Base = typename pc2l::Vector<MapPair>::Iterator;
+    using reference = MapPair &;
+
+    iterator(const Base &it) : Base(it) {}
+
+    reference operator*() const { return *Base::operator->(); }
+    reference operator[](const typename Base::difference_type &rhs) const {
+      return *(*this + rhs).operator->();
+    }
+  };
+
   // underlying vector representation of the hashmap
   Vector<MapPair> vec;
 
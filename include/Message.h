@@ -48,8 +48,10 @@
 
 #include "MPIHelper.h"
 #include "Utilities.h"
+#include <functional>
 #include <list>
 #include <memory>
+#include <vector>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
@@ -110,7 +112,12 @@ public:
     ERASE_BLOCK,     /**< Send requested cache block back */
     BLOCK_NOT_FOUND, /**< Requested block not found in cache */
     FINISH,          /**< Message to ask the worker to finish */
-    PROBE_BLOCK, /**< Check whether block is full without sending anything */
+    PROBE_BLOCK, /**< Check whether a block exists without sending it */
+    DROP_DS,     /**< Erase every block of a data structure */
+    RUN_KERNEL,  /**< Run a registered kernel on every process */
+    UPDATE_ELEMENT, /**< Apply a registered update to one value */
+    GET_BLOCKS,     /**< Send several requested cache blocks back */
+    STORE_BLOCKS,   /**< Batch of binary blobs with cache data */
     INVALID_MSG  /**< Just a placeholder */
   };
 
@@ -244,6 +251,92 @@ public:
    */
   static MessagePtr create(const Message &src);
 
+  /**
+   * Create a message that owns its buffer from data received from
+   * another process, without copying it. The buffer is allocated
+   * first and then filled in (header included) by the supplied
+   * function, e.g., via MPI_Mrecv. The fields that describe the
+   * buffer and the local state of the sender's copy (payload, ownBuf,
+   * cached, and pins) are reset afterwards.
+   *
+   * \param[in] size The total size of the message to be received,
+   * including the header.
+   *
+   * \param[in] receive The function that fills in the buffer it is
+   * passed.
+   *
+   * \return The received message.
+   */
+  static MessagePtr createReceived(const int size,
+                                   const std::function<void(char *)> &receive);
+
+  /**
+   * Create a message that owns a buffer obtained from MessagePool and
+   * filled in (header included) by a receive that has completed. The
+   * buffer may be larger than the message, e.g., when it was posted
+   * before the size of the message was known. As with createReceived,
+   * the fields that describe the sender's copy are reset.
+   *
+   * \param[in] buffer The buffer, which was obtained via
+   * MessagePool::acquire(capacity). The returned message releases it.
+   *
+   * \param[in] size The total size of the message that was received.
+   *
+   * \param[in] capacity The size with which the buffer was acquired.
+   *
+   * \return The received message.
+   */
+  static MessagePtr adopt(char *buffer, const int size, const int capacity);
+
+  /**
+   * Create a message whose payload holds copies of several messages
+   * (headers included), e.g., the cache blocks of a STORE_BLOCKS
+   * message. Each copy starts at a multiple of alignof(Message), so
+   * that unpackBatch can hand them out in place.
+   *
+   * \param[in] tag The tag to be set for the batch.
+   *
+   * \param[in] msgs The messages to be copied into the batch.
+   *
+   * \return The newly created batch.
+   *
+   * \exception Exception if the batch would not fit into a single
+   * message (see splitBatches).
+   */
+  static MessagePtr createBatch(const MsgTag tag,
+                                const std::vector<MessagePtr> &msgs);
+
+  /**
+   * The most bytes that splitBatches puts into one batch. Batches are
+   * sent as single messages, whose sizes are ints, so messages that
+   * may add up to more than this are split with splitBatches first.
+   */
+  static constexpr size_t MaxBatchSize = size_t(1) << 30;
+
+  /**
+   * Split messages into groups of consecutive messages that each fit
+   * into a batch of at most MaxBatchSize bytes. A message that is
+   * larger than that on its own forms a group by itself.
+   *
+   * \param[in] msgs The messages to be split.
+   *
+   * \return The groups of messages, in the order of \p msgs.
+   */
+  static std::vector<std::vector<MessagePtr>>
+  splitBatches(const std::vector<MessagePtr> &msgs);
+
+  /**
+   * Obtain the messages held in the payload of a batch created by
+   * createBatch. The returned messages refer to the payload of the
+   * batch (just like messages created from a buffer), so they are
+   * valid only as long as \p batch is.
+   *
+   * \param[in] batch The batch of messages.
+   *
+   * \return The messages in the batch, in the order they were added.
+   */
+  static std::vector<MessagePtr> unpackBatch(const MessagePtr &batch);
+
   /**
    * Obtain the size of the data associated with this message.
    *
@@ -350,6 +443,28 @@ public:
    */
   bool ownBuf = true;
 
+  /**
+   * Flag to indicate if the payload of this block may differ from the
+   * copy held by the worker that owns it. Blocks start out dirty and the
+   * manager clears the flag on blocks it receives from a worker, so an
+   * evicted block only has to be sent back if it was written since.
+   */
+  bool dirty = true;
+
+  /**
+   * Flag to indicate if this message is the copy of the block currently
+   * held in the local cache. It is cleared when the block is evicted or
+   * replaced, which tells data structures holding on to the message
+   * that they must fetch the block again before using it.
+   */
+  bool cached = false;
+
+  /**
+   * The number of leases (see BlockLease) currently pinning this block
+   * in the local cache. Eviction strategies skip pinned blocks.
+   */
+  unsigned int pins = 0;
+
 protected:
   /**
    * The constructor is made protected to ensure that this class is
@@ -382,6 +497,12 @@ protected:
    */
   int size;
 
+  /**
+   * The size with which the buffer of a message that owns it was
+   * obtained from MessagePool. It is at least size.
+   */
+  int capacity = 0;
+
 private:
   /** A custom deleter class to correctly delete Message objects.
    * This class is used inconjunction with the shared_ptr to
@@ -397,9 +518,17 @@ private:
      */
     void operator()(Message *msg) {
       if (msg->ownBuf) {
-        delete[] reinterpret_cast<char *>(msg);
+        release(msg);
       }
     }
+
+  private:
+    /**
+     * Return the buffer of a message that owns it to the MessagePool.
+     *
+     * @param msg Message object whose buffer is released
+     */
+    static void release(Message *msg) noexcept;
   };
 };
 
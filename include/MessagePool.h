@@ -0,0 +1,220 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+/**
+ * @file MessagePool.h
+ * @brief Definition of a pool that recycles the buffers of messages
+ * @author JD Rudie
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+
+#include "Utilities.h"
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+/**
+ * A pool of the buffers backing messages created via Message::create.
+ * Buffers are grouped into size classes (multiples of a cache line, or
+ * of a page for large buffers), so all blocks of a data structure share
+ * a class and a buffer released when a block is evicted is handed out
+ * again when a block is fetched. Buffers are aligned to a cache line
+ * (or a page, for large buffers).
+ *
+ * Each thread keeps up to LocalBuffers free buffers of each size class,
+ * which it acquires and releases without taking a lock. Beyond that,
+ * released buffers go to a pool shared by all threads, from which a
+ * thread refills its own when it runs out. So buffers released by a
+ * thread other than the one that acquired them (e.g., replies sent by
+ * the communication thread on behalf of the executors of a sharded
+ * worker) make their way back to the threads that need them instead of
+ * piling up in one thread.
+ */
+class MessagePool {
+public:
+  /**
+   * Counters describing the use of the pool by the calling thread, and
+   * the buffers the pool holds for it.
+   */
+  struct Stats {
+    /** Number of buffers that had to be allocated */
+    size_t allocated = 0;
+    /** Number of buffers handed out again from the pool */
+    size_t reused = 0;
+    /** Number of buffers returned to the pool */
+    size_t released = 0;
+    /** Number of buffers held by this thread and the shared pool */
+    size_t retainedBuffers = 0;
+    /** Number of bytes held by this thread and the shared pool */
+    size_t retainedBytes = 0;
+  };
+
+  /**
+   * Obtain a buffer of at least the given size, reusing a buffer of the
+   * same size class if the pool holds one.
+   * \param[in] size the number of bytes needed
+   * \return the buffer, which must be returned via release
+   */
+  static char *acquire(size_t size);
+
+  /**
+   * Return a buffer obtained via acquire, possibly on another thread.
+   * The buffer is kept for reuse unless the shared pool already holds
+   * as many bytes as its retain limit allows.
+   * \param[in] buffer the buffer to return
+   * \param[in] size the size passed to acquire
+   */
+  static void release(char *buffer, size_t size) noexcept;
+
+  /**
+   * Obtain the counters of the calling thread.
+   * \return the counters
+   */
+  static Stats getStats() noexcept;
+
+  /**
+   * Set the maximum number of bytes the shared pool holds on to.
+   * Buffers beyond it are freed when they are released.
+   * \param[in] bytes the maximum number of bytes
+   */
+  static void setRetainLimit(size_t bytes) noexcept;
+
+  /**
+   * Free all buffers held by the calling thread and the shared pool.
+   */
+  static void trim() noexcept;
+
+private:
+  /** Buffers of up to this size are aligned to a cache line */
+  static constexpr size_t CacheLine = 64;
+
+  /** Larger buffers are aligned to (and sized in multiples of) a page */
+  static constexpr size_t PageSize = 4096;
+
+  /** The most free buffers of a size class that a thread keeps */
+  static constexpr size_t LocalBuffers = 16;
+
+  /**
+   * Round a size up to its size class.
+   * \param[in] size the number of bytes needed
+   * \return the size of the buffers in that class
+   */
+  static size_t classSize(size_t size) noexcept {
+    const size_t unit = (size < PageSize) ? CacheLine : PageSize;
+    return (size + unit - 1) / unit * unit;
+  }
+
+  /**
+   * The free buffers of a single thread. They are handed over to the
+   * shared pool when the thread exits.
+   */
+  struct Pool {
+    /** Free buffers by size class, at most LocalBuffers each */
+    std::unordered_map<size_t, std::vector<char *>> freeLists;
+    /** The counters of this thread (retained* count freeLists only) */
+    Stats stats;
+
+    ~Pool();
+  };
+
+  /**
+   * The free buffers shared by all threads.
+   */
+  struct Shared {
+    /** Guards all other members */
+    std::mutex mutex;
+    /** Free buffers by size class */
+    std::unordered_map<size_t, std::vector<char *>> freeLists;
+    /** Number of buffers held in freeLists */
+    size_t retainedBuffers = 0;
+    /** Number of bytes held in freeLists */
+    size_t retainedBytes = 0;
+    /** The maximum number of bytes held in freeLists */
+    size_t retainLimit = 64UL * 1024 * 1024;
+
+    ~Shared();
+  };
+
+  /**
+   * Obtain the pool of the calling thread.
+   * \return the pool, or nullptr if the thread is exiting and its pool
+   * has been destroyed already
+   */
+  static Pool *local() noexcept;
+
+  /**
+   * Obtain the shared pool.
+   * \return the pool, or nullptr if the program is exiting and the pool
+   * has been destroyed already
+   */
+  static Shared *shared() noexcept;
+
+  /**
+   * Move up to LocalBuffers / 2 free buffers of a size class from the
+   * shared pool to the calling thread.
+   * \param[in,out] buffers the free buffers of the calling thread
+   * \param[in] size the size class
+   */
+  static void refill(std::vector<char *> &buffers, size_t size) noexcept;
+
+  /**
+   * Hand a buffer to the shared pool, or free it if the shared pool is
+   * full.
+   * \param[in] buffer the buffer
+   * \param[in] size its size class
+   * \return true if the buffer was kept
+   */
+  static bool share(char *buffer, size_t size) noexcept;
+
+  /**
+   * Free a buffer.
+   * \param[in] buffer the buffer
+   * \param[in] size its size class
+   */
+  static void free(char *buffer, size_t size) noexcept;
+};
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+/**
+ * @file Prefetcher.h
+ * @brief Definition of the prefetcher that predicts the blocks a data
+ * structure will access next
+ * @author JD Rudie
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+
+#include "Utilities.h"
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+/**
+ * The prefetching strategies a data structure can use
+ */
+enum PrefetchStrategy {
+  NONE = 0,            /**< No prefetching */
+  FORWARD_SEQUENTIAL,  /**< Prefetch the blocks after the accessed one */
+  BACKWARD_SEQUENTIAL, /**< Prefetch the blocks before the accessed one */
+  ADAPTIVE             /**< Detect the stride of the accesses and prefetch
+                          the blocks along it */
+};
+
+/**
+ * Predicts the blocks that will be accessed next from the indices that
+ * are accessed. The sequential strategies assume a stride of +1 or -1
+ * values. The adaptive strategy learns the stride from the distance
+ * between consecutive accesses, so forward and backward walks as well
+ * as constant-stride walks (e.g., down the column of a row-major
+ * matrix) are recognized; a stride is only acted on once it has been
+ * seen twice in a row.
+ *
+ * Predictions are made whenever an access moves to a different block.
+ * The prefetcher keeps the blocks it predicted (but that were not
+ * accessed yet) to count how many predictions were useful.
+ */
+class Prefetcher {
+public:
+  /**
+   * Create a prefetcher.
+   * \param[in] strategy the prefetching strategy to be used
+   * \param[in] blockElementCount the number of values in each block
+   */
+  Prefetcher(PrefetchStrategy strategy, size_t blockElementCount) noexcept;
+
+  /**
+   * Note an access to the value at \p index and predict the blocks that
+   * are going to be accessed after it.
+   * \param[in] index index of the value that is accessed
+   * \param[in] blockCount the number of blocks in the data structure;
+   * no blocks beyond it are predicted
+   * \param[in] depth the maximum number of blocks to be predicted
+   * \return tags of the blocks to be fetched ahead of time (empty unless
+   * the access moved to another block and the stride is known). Blocks
+   * that were predicted earlier are not repeated.
+   */
+  const std::vector<size_t> &observe(size_t index, size_t blockCount,
+                                     unsigned int depth);
+
+  /**
+   * Obtain the stride (in values) that predictions are based on.
+   * \return the stride, or 0 if no stride is known (yet)
+   */
+  long long getStride() const noexcept {
+    return (confidence > 0) ? stride : 0;
+  }
+
+  /**
+   * Obtain the number of blocks that were predicted.
+   */
+  size_t getIssued() const noexcept { return issued; }
+
+  /**
+   * Obtain the number of accesses to a block that had been predicted.
+   */
+  size_t getUseful() const noexcept { return useful; }
+
+  /**
+   * Obtain the number of accesses to a block that had not been
+   * predicted.
+   */
+  size_t getMissed() const noexcept { return missed; }
+
+  /**
+   * Obtain the fraction of predicted blocks that were then accessed.
+   * \return the accuracy of the predictions, in [0, 1]
+   */
+  double getAccuracy() const noexcept;
+
+  /**
+   * Obtain the fraction of accesses to another block that went to a
+   * predicted block.
+   * \return the coverage of the predictions, in [0, 1]
+   */
+  double getCoverage() const noexcept;
+
+private:
+  /** Whether the stride is learned from the accesses */
+  bool adaptive;
+
+  /** The number of values in each block */
+  size_t blockElementCount;
+
+  /** The stride (in values) predictions are based on */
+  long long stride;
+
+  /** How often in a row the stride was seen (capped at 2) */
+  unsigned int confidence;
+
+  /** Index of the previously accessed value */
+  size_t lastIndex = 0;
+
+  /** Tag of the previously accessed block */
+  size_t lastBlock = -1UL;
+
+  /** Predicted blocks that were not accessed yet, oldest first */
+  std::deque<size_t> predicted;
+
+  /** Buffer for the blocks returned by observe */
+  std::vector<size_t> toFetch;
+
+  /** Counters reported by the getters */
+  size_t issued = 0, useful = 0, missed = 0;
+};
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
@@ -71,6 +71,10 @@ private:
 
   void eraseFromCache(size_t key) override;
 
+  size_t eraseDsFromCache(size_t dsTag) override;
+
+  std::vector<MessagePtr> getDsFromCache(size_t dsTag) override;
+
   void addToCache(pc2l::MessagePtr &msg) override;
 
   MessagePtr &getFromCache(size_t key) override;
@@ -0,0 +1,279 @@
+#ifndef SPARSE_VECTOR_H
+#define SPARSE_VECTOR_H
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+/**
+ * @file SparseVector.h
+ * @brief Definition of a distributed vector whose absent blocks read as a
+ * default value
+ * @author JD Rudie
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+
+#include "CacheManager.h"
+#include "Exception.h"
+#include "Message.h"
+#include "System.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+/**
+ * A distributed vector over a (possibly huge) index space in which most
+ * values are a default value. Blocks are only created when a value other
+ * than the default is written to them, and values in blocks that were
+ * never created read as the default value.
+ *
+ * The manager keeps a bitmap of the blocks that exist. The bitmap is
+ * stored as a hash map of 64-bit words, so its size grows with the
+ * number of regions that are in use rather than with the size of the
+ * index space. Reads of absent blocks are answered from the bitmap
+ * without any messages to the workers.
+ *
+ * @tparam T the type of the values. It must be trivially copyable, since
+ * values are stored as raw bytes in blocks.
+ * @tparam UserBlockSize the (approximate) size of a block in bytes
+ */
+template <typename T, unsigned int UserBlockSize = 4096> class SparseVector {
+public:
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SparseVector stores values as raw bytes");
+
+  // Count the number of values of type T in a single block
+  static constexpr unsigned int BlockElementCount =
+      std::max<unsigned int>(1, UserBlockSize / sizeof(T));
+  static constexpr unsigned int BlockSize = BlockElementCount * sizeof(T);
+
+  /**
+   * Create a sparse vector in which every value is \p defaultValue.
+   * Nothing is stored until a different value is written.
+   * @param size the number of values in the vector
+   * @param defaultValue the value of every value that was not written
+   */
+  explicit SparseVector(unsigned long long size = 0,
+                        const T &defaultValue = T{})
+      : dsTag(System::get().dsCount++), siz(size),
+        defaultValue(defaultValue) {}
+
+  SparseVector(const SparseVector &) = delete;
+  SparseVector &operator=(const SparseVector &) = delete;
+
+  /**
+   * The destructor. Releases the blocks of this vector on the manager
+   * and on every worker.
+   */
+  ~SparseVector() { System::get().cacheManager().dropDataStructure(dsTag); }
+
+  /**
+   * Returns size (in values, not blocks) of vector
+   * @return size (in values) of vector
+   */
+  unsigned long long size() const { return siz; }
+
+  /**
+   * Obtain the value that values which were never written read as.
+   * @return the default value
+   */
+  const T &getDefault() const { return defaultValue; }
+
+  /**
+   * Obtain the number of blocks that exist.
+   * @return the number of blocks that were created by writes
+   */
+  size_t storedBlocks() const { return blockCount; }
+
+  /**
+   * Check whether the block holding the value at \p index exists.
+   * @param index index of the value
+   * @return true if the value at \p index is stored in a block
+   */
+  bool hasBlock(size_t index) const {
+    checkIndex(index);
+    return blockExists(index / BlockElementCount);
+  }
+
+  /**
+   * Obtain the value at \p index. If its block does not exist, the
+   * default value is returned without contacting any worker.
+   * @param index index of the value
+   * @return the value at \p index
+   */
+  T at(size_t index) const {
+    checkIndex(index);
+    const size_t blockTag = index / BlockElementCount;
+    if (!blockExists(blockTag)) {
+      return defaultValue;
+    }
+    const T *values =
+        reinterpret_cast<const T *>(fetchBlock(blockTag)->getPayload());
+    return values[index % BlockElementCount];
+  }
+
+  /**
+   * Obtain the value at \p index (see at).
+   * @param index index of the value
+   * @return the value at \p index
+   */
+  T operator[](size_t index) const { return at(index); }
+
+  /**
+   * Write \p value at \p index. Writing the default value into a block
+   * that does not exist does nothing; otherwise the block is created
+   * (with every other value set to the default value) as needed.
+   * @param index index of the value to be written
+   * @param value the value to be written
+   */
+  void set(size_t index, const T &value) {
+    checkIndex(index);
+    const size_t blockTag = index / BlockElementCount;
+    MessagePtr msg;
+    if (blockExists(blockTag)) {
+      msg = fetchBlock(blockTag);
+    } else if (std::memcmp(static_cast<const void *>(&value),
+                           static_cast<const void *>(&defaultValue),
+                           sizeof(T)) == 0) {
+      return;
+    } else {
+      msg = Message::create(BlockSize, Message::STORE_BLOCK, 0, dsTag,
+                            blockTag);
+      std::fill_n(reinterpret_cast<T *>(msg->getPayload()),
+                  BlockElementCount, defaultValue);
+      System::get().cacheManager().storeCacheBlock(msg);
+      blockBits[blockTag / 64] |= std::uint64_t(1) << (blockTag % 64);
+      blockCount++;
+      prevMsg = msg;
+      prevBlockTag = blockTag;
+    }
+    msg->dirty = true;
+    std::memcpy(msg->getPayload() + (index % BlockElementCount) * sizeof(T),
+                static_cast<const void *>(&value), sizeof(T));
+  }
+
+  /**
+   * Call \p fn(size_t first, const T *values, size_t count) once for
+   * each block that exists, in no particular order. The block holds the
+   * values at indices [first, first + count); absent blocks are skipped.
+   * @param fn callable that is given the values of each block
+   */
+  template <typename Fn> void for_each_block(Fn fn) const {
+    for (const auto &[word, bits] : blockBits) {
+      for (unsigned int bit = 0; bit < 64; bit++) {
+        if ((bits >> bit) & 1) {
+          const size_t blockTag = word * 64 + bit;
+          const size_t first = blockTag * BlockElementCount;
+          fn(first,
+             reinterpret_cast<const T *>(fetchBlock(blockTag)->getPayload()),
+             std::min<size_t>(BlockElementCount, siz - first));
+        }
+      }
+    }
+  }
+
+  // unique identifier for this data structure
+  const size_t dsTag;
+
+private:
+  /**
+   * Throw an exception if \p index is outside the vector.
+   * @param index the index to be checked
+   */
+  void checkIndex(size_t index) const {
+    if (index >= siz) {
+      throw PC2L_EXP("Index %zu is out of range (size is %llu)",
+                     "Ensure the index lies within the vector", index, siz);
+    }
+  }
+
+  /**
+   * Check the bitmap of existing blocks.
+   * @param blockTag the block tag of the block to be checked
+   * @return true if the block exists
+   */
+  bool blockExists(size_t blockTag) const {
+    const auto word = blockBits.find(blockTag / 64);
+    return word != blockBits.end() && ((word->second >> (blockTag % 64)) & 1);
+  }
+
+  /**
+   * Obtain the message containing block \p blockTag, which must exist.
+   * The most recently retrieved block is reused as long as it is still
+   * in the manager cache.
+   * @param blockTag the block tag of the block to be retrieved
+   * @return reference to the message containing the block
+   */
+  const MessagePtr &fetchBlock(size_t blockTag) const {
+    if (blockTag != prevBlockTag || !prevMsg || !prevMsg->cached) {
+      prevMsg =
+          System::get().cacheManager().getBlockFallbackRemote(dsTag, blockTag);
+      prevBlockTag = blockTag;
+      if (prevMsg == nullptr) {
+        throw PC2L_EXP("Block %zu of sparse vector %zu is missing",
+                       "The block was released elsewhere", blockTag, dsTag);
+      }
+    }
+    return prevMsg;
+  }
+
+  // The number of values in the vector
+  const unsigned long long siz;
+
+  // The value of every value that was not written
+  const T defaultValue;
+
+  // Bitmap of existing blocks: bit b of word w is block 64 * w + b
+  std::unordered_map<size_t, std::uint64_t> blockBits;
+
+  // The number of existing blocks (i.e., bits set in blockBits)
+  size_t blockCount = 0;
+
+  // block tag of last retrieved block
+  mutable size_t prevBlockTag = 0;
+
+  // reference to message containing last retrieved block
+  mutable MessagePtr prevMsg;
+};
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
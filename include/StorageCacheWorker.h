@@ -48,12 +48,22 @@
 
 #include "CacheWorker.h"
 #include "Utilities.h"
+#include <algorithm>
 #include <list>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
 class StorageCacheWorker : public virtual CacheWorker {
 public:
+  /**
+   * Create a worker whose cache is split into a given number of shards,
+   * each served by its own thread (see CacheWorker::run).
+   * @param shardCount the number of shards, 1 to serve all requests on
+   * the thread running the worker
+   */
+  explicit StorageCacheWorker(size_t shardCount = 1)
+      : shards(std::max<size_t>(shardCount, 1)) {}
+
   /**
    * Refer the key for a block to our eviction scheme
    * @param key the key to place into eviction scheme
@@ -67,8 +77,17 @@ protected:
 
   void eraseFromCache(size_t key) override;
 
+  size_t eraseDsFromCache(size_t dsTag) override;
+
+  std::vector<MessagePtr> getDsFromCache(size_t dsTag) override;
+
+  size_t getShardCount() const noexcept override { return shards.size(); }
+
+  size_t getShard(size_t key) const noexcept override;
+
 private:
-  std::unordered_map<size_t, MessagePtr> cache;
+  /** The blocks stored by this worker, split into shards by key */
+  std::vector<DataCache> shards;
 };
 
 END_NAMESPACE(pc2l);
@@ -76,6 +76,15 @@ public:
 
   // default cache size
   unsigned long long cacheSize;
+
+  // limit on bytes of evicted blocks being written back (0: cacheSize)
+  unsigned long long writeBackLimit = 0;
+
+  // number of threads serving requests on each worker
+  unsigned int workerThreads = 1;
+
+  // whether the manager runs a thread that progresses MPI traffic
+  bool progressThread = false;
   /**
    * Enumeration to define the global operation mode for a specific
    * run of PC2L.  Currently, the library only supports a single
@@ -194,12 +203,47 @@ public:
    */
   int worldSize() noexcept;
 
+  /**
+   * The MPI rank of this process. It is obtained once by initialize, so
+   * unlike MPI_GET_RANK it makes no MPI call, which the application
+   * thread must not do while the manager's progress thread runs.
+   */
+  int worldRank() noexcept;
+
   /**
    * Set the cache size of the System's cache manager
    * @param cSize maximum size in bytes of CM's cache
    */
   void setCacheSize(unsigned long long cSize) noexcept;
 
+  /**
+   * Set the maximum number of bytes held by evicted blocks that the
+   * System's cache manager is still writing back
+   * @param limit maximum size in bytes, or 0 to use the cache size
+   */
+  void setWriteBackLimit(unsigned long long limit) noexcept;
+
+  /**
+   * Set the number of threads serving requests on each worker process.
+   * With more than one thread, a worker's blocks are split into as many
+   * shards, each served by its own thread, while the thread that runs
+   * the worker receives requests and sends replies.
+   * @param threads the number of threads, 1 to serve requests on the
+   * thread that runs the worker
+   */
+  void setWorkerThreads(unsigned int threads) noexcept;
+
+  /**
+   * Set whether the manager runs a thread that keeps prefetches and
+   * write-backs progressing while the application computes. This
+   * requires MPI to provide MPI_THREAD_SERIALIZED (which initialize
+   * asks for); otherwise the setting has no effect. While the thread
+   * runs, the application must leave MPI calls to the library (use
+   * worldRank rather than MPI_GET_RANK).
+   * @param enable true to run the thread
+   */
+  void setProgressThread(bool enable) noexcept;
+
   pc2l::CacheManager &cacheManager();
 
 protected:
@@ -235,6 +279,11 @@ private:
    */
   int size;
 
+  /**
+   * The MPI rank of this process
+   */
+  int rank;
+
   /**
    * The default constructor has been made private to ensure that
    * this class is never instantiated.  Instead, use the global
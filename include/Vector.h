@@ -45,22 +45,25 @@
  *
  */
 
+#include "BlockLease.h"
 #include "CacheManager.h"
+#include "Kernel.h"
 #include "Message.h"
+#include "Prefetcher.h"
 #include "System.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <vector>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
 
-enum PrefetchStrategy {
-  NONE = 0,
-  FORWARD_SEQUENTIAL,
-  BACKWARD_SEQUENTIAL,
-
-};
-
 /**
  * A distributed vector that runs across multiple machines
  * utilizing message passing through MPI. This initial
@@ -71,59 +74,232 @@ template <typename T, unsigned int UserBlockSize = 4096,
 class Vector {
 public:
   /**
-   * Customer iterator for a PC2L vector. As of right now,
-   * only an input iterator is implemented.
-   * TODO: need a custom reference to replace reference
+   * A reference to a value in the vector, handed out by operator[] and
+   * by iterators in place of a T&. Reading the value goes through the
+   * same single-block fast path as at(). Assigning a value writes it into
+   * the cached block right away and marks the block dirty, so the write
+   * cannot be lost to an eviction that happens before the block is
+   * stored again. References handed out by an iterator also point
+   * straight at the value in the iterator's block and use it for as long
+   * as the block stays cached, so they must not outlive the iterator.
+   */
+  class Reference {
+  public:
+    // declare friend class so only pc2l::Vector can create references
+    friend class Vector;
+
+    operator T() const {
+      return (block != nullptr && block->cached) ? *value : vec.at(i);
+    }
+
+    Reference &operator=(const T &val) {
+      if (block != nullptr && block->cached) {
+        std::memcpy(static_cast<void *>(value), &val, sizeof(T));
+        block->dirty = true;
+      } else {
+        vec.write(i, val);
+      }
+      return *this;
+    }
+    Reference &operator=(const Reference &rhs) {
+      return *this = static_cast<T>(rhs);
+    }
+
+    // Compound assignments read the value and write the result back as
+    // operator= does, so they mark the block dirty too
+    template <typename U> Reference &operator+=(const U &rhs) {
+      return *this = static_cast<T>(static_cast<T>(*this) + rhs);
+    }
+    template <typename U> Reference &operator-=(const U &rhs) {
+      return *this = static_cast<T>(static_cast<T>(*this) - rhs);
+    }
+    Reference &operator++() {
+      T val = *this;
+      return *this = ++val;
+    }
+    Reference &operator--() {
+      T val = *this;
+      return *this = --val;
+    }
+    T operator++(int) {
+      const T old = *this;
+      ++*this;
+      return old;
+    }
+    T operator--(int) {
+      const T old = *this;
+      --*this;
+      return old;
+    }
+
+    /**
+     * Access members of a value of class type in place. The block is
+     * marked dirty, since members may be written through the pointer.
+     * The pointer refers into the cached block, which any later call
+     * into the vector (or another vector) may evict, so it must only be
+     * used within the expression it appears in, e.g., vec[i]->x = 1.
+     */
+    template <typename U = T, typename = std::enable_if_t<std::is_class_v<U>>>
+    U *operator->() const {
+      return vec.ptr(i);
+    }
+
+    /**
+     * Index into a value of class type in place (e.g., a character of a
+     * std::array<char, N>). The result refers into the cached block, so
+     * as with operator-> it must only be used within the expression it
+     * appears in.
+     */
+    template <typename Index, typename U = T,
+              typename = std::enable_if_t<std::is_class_v<U>>>
+    decltype(auto) operator[](Index idx) const {
+      return (*vec.ptr(i))[idx];
+    }
+
+    friend void swap(Reference lhs, Reference rhs) {
+      const T tmp = lhs;
+      lhs = rhs;
+      rhs = tmp;
+    }
+
+    friend bool operator==(const Reference &lhs, const Reference &rhs) {
+      return static_cast<T>(lhs) == static_cast<T>(rhs);
+    }
+    template <typename U>
+    friend bool operator==(const Reference &lhs, const U &rhs) {
+      return static_cast<T>(lhs) == rhs;
+    }
+    template <typename U>
+    friend bool operator==(const U &lhs, const Reference &rhs) {
+      return lhs == static_cast<T>(rhs);
+    }
+    friend bool operator!=(const Reference &lhs, const Reference &rhs) {
+      return !(lhs == rhs);
+    }
+    template <typename U>
+    friend bool operator!=(const Reference &lhs, const U &rhs) {
+      return !(lhs == rhs);
+    }
+    template <typename U>
+    friend bool operator!=(const U &lhs, const Reference &rhs) {
+      return !(lhs == rhs);
+    }
+    friend bool operator<(const Reference &lhs, const Reference &rhs) {
+      return static_cast<T>(lhs) < static_cast<T>(rhs);
+    }
+    template <typename U>
+    friend bool operator<(const Reference &lhs, const U &rhs) {
+      return static_cast<T>(lhs) < rhs;
+    }
+    template <typename U>
+    friend bool operator<(const U &lhs, const Reference &rhs) {
+      return lhs < static_cast<T>(rhs);
+    }
+
+  private:
+    Reference(Vector &vec, size_t i, T *value = nullptr,
+              Message *block = nullptr)
+        : vec(vec), i(i), value(value), block(block) {}
+    Vector &vec;
+    size_t i;
+    // the value within block, if the reference came from an iterator
+    T *value;
+    Message *block;
+  };
+
+  /**
+   * Customer iterator for a PC2L vector. Dereferencing the iterator
+   * yields a Reference, so values can be read and written by std
+   * algorithms without going through replace(). The iterator works as a
+   * cursor: it holds on to the block containing the current value and a
+   * pointer to the value, so stepping within a block is a pointer bump
+   * and only crossing into another block goes through the CacheManager.
+   * The block is pinned with a BlockLease while the iterator is on it,
+   * and released when the iterator moves to another block. If the pin
+   * cannot be taken (because half of the cache is pinned already), the
+   * iterator checks whether the block was evicted on every access.
    */
   class Iterator {
   public:
     using iterator_category = std::random_access_iterator_tag;
     using value_type = T;
     using difference_type = size_t;
-    // remove pointer type?
     using pointer = T *;
-    using reference = T &;
+    using reference = Reference;
+    // the type of vector the iterator walks, see IsSegmentedIterator
+    using vector_type = Vector;
 
     Iterator();
 
     // declare friend class so only pc2l::Vector can access Iterator's private
     // constructor
-    friend class Vector<T, UserBlockSize>;
+    friend class Vector;
 
     // Maybe implement bounds check here? Or bounds check in pc2l::Vector
     inline Iterator &operator++() {
       i++;
+      if (cur != nullptr && ++cur == blockEnd) {
+        leaveBlock();
+      }
       return *this;
     }
     inline Iterator &operator--() {
       i--;
+      if (cur != nullptr) {
+        if (cur == blockEnd - BlockElementCount) {
+          leaveBlock();
+        } else {
+          cur--;
+        }
+      }
       return *this;
     }
     inline Iterator &operator=(const Iterator &rhs) {
       i = rhs.i;
+      block = rhs.block;
+      cur = rhs.cur;
+      blockEnd = rhs.blockEnd;
+      lease = rhs.lease ? BlockLease(block, std::nothrow) : BlockLease();
       return *this;
     }
     inline Iterator &operator+=(const difference_type &rhs) {
       i += rhs;
+      leaveBlock();
       return *this;
     }
     inline Iterator &operator+=(const Iterator &rhs) {
       i += rhs.i;
+      leaveBlock();
       return *this;
     }
     inline Iterator &operator-=(const difference_type &rhs) {
       i -= rhs;
+      leaveBlock();
       return *this;
     }
     inline Iterator &operator-=(const Iterator &rhs) {
       i -= rhs.i;
+      leaveBlock();
       return *this;
     }
 
-    pointer operator->() const { return vec.ptr(i); }
-    // TODO: Redefine reference type with custom reference
-    reference operator[](const difference_type &rhs) const { return vec[rhs]; }
-    reference operator*() const { return vec[i]; };
+    pointer operator->() const {
+      pointer value = resolve();
+      if (!block->cached) {
+        // a zero page has to be materialized before it is written to
+        cur = nullptr;
+        return vec.ptr(i);
+      }
+      block->dirty = true;
+      return value;
+    }
+    reference operator[](const difference_type &rhs) const {
+      return vec[i + rhs];
+    }
+    reference operator*() const {
+      pointer value = resolve();
+      return Reference(vec, i, value, block.get());
+    };
 
     difference_type operator-(const Iterator &rhs) { return i - rhs.i; }
     Iterator operator+(const difference_type &rhs) const {
@@ -145,16 +321,67 @@ public:
     bool operator!=(const Iterator &rhs) const { return !(*this == rhs); }
     bool operator<(const Iterator &rhs) const { return i < rhs.i; }
     bool operator>(const Iterator &rhs) const { return i > rhs.i; }
-    bool operator<=(const Iterator &rhs) const { return i >= rhs.i; }
+    bool operator<=(const Iterator &rhs) const { return i <= rhs.i; }
     bool operator>=(const Iterator &rhs) const { return i >= rhs.i; }
 
-    Iterator(const Iterator &other) : vec(other.vec), i(other.i) {}
+    /**
+     * Obtain the vector this iterator walks
+     * @return reference to the vector
+     */
+    Vector &container() const { return vec; }
+
+    Iterator(const Iterator &other)
+        : vec(other.vec), i(other.i), block(other.block), cur(other.cur),
+          blockEnd(other.blockEnd),
+          lease(other.lease ? BlockLease(block, std::nothrow) : BlockLease()) {
+    }
     size_t i = 0;
 
   private:
-    Iterator(Vector<T, UserBlockSize> &vec, const size_t end = 0)
-        : vec(vec), i(end) {}
-    Vector<T, UserBlockSize> &vec;
+    Iterator(Vector &vec, const size_t end = 0) : vec(vec), i(end) {}
+
+    /**
+     * Obtain a pointer to the current value, fetching the block that
+     * holds it if the iterator moved to another block or the block it
+     * holds was evicted from the manager cache.
+     * @return pointer to the current value
+     */
+    pointer resolve() const {
+      if (cur == nullptr || !block->cached) {
+        // the block we leave may be evicted to make room for the next
+        lease.release();
+        const auto [offset, blockTag, inBlockIdx] = indexCalculation(i);
+        vec.prefetch(i);
+        block = vec.fetchBlock(blockTag);
+        // zero pages are read from a block that is never cached
+        if (block->cached) {
+          lease = BlockLease(block, std::nothrow);
+        }
+        T *values = reinterpret_cast<T *>(block->getPayload());
+        cur = values + (i % BlockElementCount);
+        blockEnd = values + BlockElementCount;
+      }
+      return cur;
+    }
+
+    /**
+     * Forget the current block, so that it is looked up again when the
+     * iterator is dereferenced, and unpin it.
+     */
+    void leaveBlock() {
+      cur = nullptr;
+      lease.release();
+    }
+
+    Vector &vec;
+    // the block holding the current value while cur is set
+    mutable MessagePtr block;
+    // the current value, or nullptr if it has to be looked up again
+    mutable T *cur = nullptr;
+    // one past the last value that fits in block
+    mutable T *blockEnd = nullptr;
+    // pins block while the iterator is on it, if the pin could be taken
+    mutable BlockLease lease;
   };
 
   // Iterator methods
@@ -171,16 +398,94 @@ public:
    */
   Vector() : siz(0), dsTag(System::get().dsCount++) {}
 
-  Vector(unsigned long long fillCount)
+  /**
+   * Create a vector holding \p fillCount copies of \p value. The values
+   * are written a whole block at a time (see append).
+   * @param fillCount number of values in the new vector
+   * @param value value to be copied into every position
+   */
+  Vector(unsigned long long fillCount, const T &value = T{})
       : siz(0), dsTag(System::get().dsCount++) {
-    for (auto i = 0; i < fillCount; i++) {
-      insert(0, T{});
+    if constexpr (std::is_trivial_v<T>) {
+      const auto *bytes = reinterpret_cast<const unsigned char *>(&value);
+      if (std::all_of(bytes, bytes + sizeof(T),
+                      [](unsigned char b) { return b == 0; })) {
+        // a vector of zeros is made of zero pages, so it is created at
+        // once and takes no memory until it is written to
+        resize(fillCount);
+        return;
+      }
+    }
+    appendBlocks(fillCount, [&value](T *dst, size_t count) {
+      std::uninitialized_fill_n(dst, count, value);
+    });
+  }
+
+  /**
+   * The copy constructor. The copy gets its own data structure tag and
+   * its own copy of every block, so changes to either vector are not
+   * seen by the other.
+   * @param other the vector to be copied
+   */
+  Vector(const Vector &other) : siz(0), dsTag(System::get().dsCount++) {
+    appendFrom(other);
+  }
+
+  /**
+   * The move constructor. The blocks of \p other are taken over as they
+   * are, and \p other is left as an empty vector with a fresh tag.
+   * @param other the vector to be moved from
+   */
+  Vector(Vector &&other) noexcept
+      : siz(0), dsTag(System::get().dsCount++) {
+    swapContents(other);
+  }
+
+  /**
+   * The copy assignment operator. Blocks held by this vector are
+   * released before the values of \p other are copied.
+   * @param other the vector to be copied
+   * @return reference to this vector
+   */
+  Vector &operator=(const Vector &other) {
+    if (this != &other) {
+      clear();
+      appendFrom(other);
+    }
+    return *this;
+  }
+
+  /**
+   * The move assignment operator. Blocks held by this vector are
+   * released before the blocks of \p other are taken over. Not
+   * noexcept, since releasing the blocks involves messages to the
+   * workers, which may fail.
+   * @param other the vector to be moved from
+   * @return reference to this vector
+   */
+  Vector &operator=(Vector &&other) {
+    if (this != &other) {
+      clear();
+      swapContents(other);
     }
+    return *this;
   }
+
   /**
-   * The destructor.
+   * The destructor. Releases the blocks of this vector on the manager
+   * and on every worker. Vectors that never stored a block (e.g., ones
+   * that were moved from) have nothing to release.
    */
-  virtual ~Vector() = default;
+  virtual ~Vector() {
+    if (!stored) {
+      return;
+    }
+    try {
+      System::get().cacheManager().dropDataStructure(dsTag);
+    } catch (const std::exception &) {
+      // a destructor must not throw; the blocks are merely left behind
+    }
+  }
 
   // unique identifier for this data structure
   size_t dsTag;
@@ -191,8 +496,24 @@ public:
   // block tag of last retrieved block
   mutable size_t prevBlockTag = 0;
 
+  // whether a block of this vector may exist in a cache, i.e., whether
+  // there is anything for dropDataStructure to release
+  mutable bool stored = false;
+
   // reference to message containing last retrieved block
   mutable MessagePtr prevMsg;
+
+  // predicts the blocks to be prefetched from the accessed indices
+  mutable Prefetcher prefetcher{PFStrategy, BlockElementCount};
+
+  // Runs of zero pages, as [begin, end) ranges of block tags keyed by
+  // begin: they were added by resize and have never been written, so
+  // they exist neither in the cache nor on any worker. Writing a zero
+  // page (see materialize) shrinks or splits its run.
+  mutable std::map<size_t, size_t> zeroRuns;
+
+  // the largest number of values passed to reserve
+  size_t reserved = 0;
   // calculate log2(n) at compile time
   static constexpr unsigned int log2(unsigned int n) { return std::log2(n); }
   // Calculate a^n at compile time
@@ -208,58 +529,148 @@ public:
   static constexpr unsigned int BlockSize = pow(2, BlockShiftBits);
   static constexpr unsigned int TypeSize = sizeof(T);
   static constexpr unsigned int IndexMask = BlockSize - 1;
-  // Count the number of elements of type T in a single block for prefetching
-  // purposes
+  // Count the number of elements of type T in a single block. Blocks only
+  // hold whole elements, so an element never straddles two blocks
   static constexpr unsigned int BlockElementCount = BlockSize / TypeSize;
+  static_assert(BlockElementCount > 0,
+                "Block size must be large enough to hold one element");
   /**
-   * Prefetch the next block if necessary. Will eventually be a bunch of
-   * ifdefs depending on some prefetching strategy specified as a template
-   * argument
+   * Note an access to the value at \p index with the prefetcher and
+   * start fetching the blocks it predicts will be accessed next, up to
+   * PrefetchCount blocks ahead. The blocks arrive in the background
+   * (see CacheManager::prefetchBlock) while the caller keeps working on
+   * the current block. At most half of the cache is used for prefetched
+   * blocks, so that they do not push out the blocks in use. Does nothing
+   * if PFStrategy is NONE.
+   * @param index index of the value that is accessed
    */
-  void prefetch(size_t inBlockIdx, size_t blockTag) const {
-    if constexpr (PFStrategy == PrefetchStrategy::FORWARD_SEQUENTIAL) {
-      if (BlockSize - inBlockIdx + 1 >= PrefetchCount &&
-          (siz / BlockSize) > blockTag + 1) {
-        auto &pc2l = pc2l::System::get();
-        pc2l.cacheManager().getBlockFallbackRemote(dsTag, blockTag + 1);
+  void prefetch(size_t index) const {
+    if constexpr (PFStrategy != PrefetchStrategy::NONE) {
+      CacheManager &cm = System::get().cacheManager();
+      const auto cacheBlocks = cm.cacheSize / (BlockSize + sizeof(Message));
+      const auto depth = static_cast<unsigned int>(
+          std::min<unsigned long long>(PrefetchCount, cacheBlocks / 2));
+      const size_t blockCount =
+          (siz + BlockElementCount - 1) / BlockElementCount;
+      for (const auto tag : prefetcher.observe(index, blockCount, depth)) {
+        if (!isZeroPage(tag)) {
+          cm.prefetchBlock(dsTag, tag, BlockSize + sizeof(Message));
+        }
       }
-    } else if constexpr (PFStrategy == PrefetchStrategy::BACKWARD_SEQUENTIAL) {
     }
   }
 
+  /**
+   * Obtain the prefetcher of this vector, e.g., to check the accuracy
+   * and coverage of its predictions.
+   * @return the prefetcher of this vector
+   */
+  const Prefetcher &getPrefetcher() const { return prefetcher; }
+
   /**
    * Returns size (in values, not blocks) of vector
    * @return size (in values) of vector
    */
   unsigned long long size() const { return siz; }
 
-  T &operator[](size_t index) {
-    auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
+  /**
+   * Obtain a reference to the value at \p index. The reference reads and
+   * writes the value through the cache (see Reference).
+   * @param index index of the value
+   * @return reference to the value at \p index
+   */
+  Reference operator[](size_t index) { return Reference(*this, index); }
 
-    prefetch(inBlockIdx, blockTag);
-    if (blockTag == prevBlockTag) {
-      // if the CacheManager's cache contains this block, just get it
-      // get array of concatenated T-serializations
-      char *payload = prevMsg->getPayload();
-      return *reinterpret_cast<T *>(payload + inBlockIdx);
+  /**
+   * Erase all values from vector. Rather than erasing values one at a
+   * time, every block of the vector is released with a single message
+   * to each worker.
+   */
+  void clear() {
+    if (stored) {
+      System::get().cacheManager().dropDataStructure(dsTag);
+      stored = false;
     }
-    CacheManager &cm = System::get().cacheManager();
-    MessagePtr msg = cm.getBlockFallbackRemote(dsTag, blockTag);
-    prevBlockTag = blockTag;
-    prevMsg = msg;
-    // if the CacheManager's cache contains this block, just get it
-    // get array of concatenated T-serializations
-    char *payload = msg->getPayload();
-    return *reinterpret_cast<T *>(payload + inBlockIdx);
+    siz = 0;
+    prevMsg = nullptr;
+    prevBlockTag = 0;
+    zeroRuns.clear();
   }
 
   /**
-   * Erase all values from vector
+   * Change the size of the vector to \p n values. Values past \p n are
+   * erased. New values are value-initialized (i.e., zero for trivial
+   * types). For trivial types, the blocks that only hold new values are
+   * not created at all: they are recorded as zero pages, which are read
+   * from a shared block of zeros and created (in the manager cache) only
+   * when first written to. So growing a vector by any amount is
+   * immediate and takes no memory on the workers until it is written.
+   * @param n the new number of values in the vector
    */
-  void clear() {
-    for (unsigned long long i = 0; i < siz; i++) {
-      erase(i);
+  void resize(size_t n) {
+    if (n <= siz) {
+      erase(n, siz);
+      return;
+    }
+    if constexpr (!std::is_trivial_v<T>) {
+      appendBlocks(n - siz, [](T *dst, size_t count) {
+        std::uninitialized_value_construct_n(dst, count);
+      });
+    } else {
+      const size_t firstZero = (siz + BlockElementCount - 1) / BlockElementCount;
+      const size_t endZero = (n + BlockElementCount - 1) / BlockElementCount;
+      // the tail of the last block may still hold erased values
+      if (const size_t tail = std::min(n, firstZero * BlockElementCount);
+          siz < tail && !isZeroPage(siz / BlockElementCount)) {
+        T *values =
+            reinterpret_cast<T *>(fetchBlockForWrite(siz / BlockElementCount)
+                                      ->getPayload());
+        std::fill(values + siz % BlockElementCount,
+                  values + (tail - 1) % BlockElementCount + 1, T{});
+      }
+      if (firstZero < endZero) {
+        if (!zeroRuns.empty() && zeroRuns.rbegin()->second == firstZero) {
+          zeroRuns.rbegin()->second = endZero;
+        } else {
+          zeroRuns.emplace(firstZero, endZero);
+        }
+      }
+      siz = n;
+    }
+  }
+
+  /**
+   * Note that the vector is expected to grow to \p n values. Blocks are
+   * only created when values are written to them, so there is no
+   * storage to set aside up front: this only raises capacity, as with
+   * std::vector. Use resize to create a vector of zeros that is backed
+   * by zero pages.
+   * @param n the number of values to reserve room for
+   */
+  void reserve(size_t n) { reserved = std::max<size_t>(reserved, n); }
+
+  /**
+   * Obtain the number of values the vector can hold without starting a
+   * new block, or the number passed to reserve if that is larger.
+   * @return the capacity of the vector (in values)
+   */
+  size_t capacity() const {
+    const size_t blocks = (siz + BlockElementCount - 1) / BlockElementCount;
+    return std::max<size_t>(reserved, blocks * BlockElementCount);
+  }
+
+  /**
+   * Turn every zero page into a real block. This is needed before
+   * kernels work on the blocks at the workers, which never see zero
+   * pages.
+   */
+  void materializeZeroPages() {
+    for (const auto &[begin, end] : zeroRuns) {
+      for (size_t blockTag = begin; blockTag < end; blockTag++) {
+        storeZeroBlock(blockTag);
+      }
     }
+    zeroRuns.clear();
   }
 
   /**
@@ -279,13 +690,37 @@ public:
    */
   void erase(unsigned long long index) {
     PC2L_DEBUG_START_TIMER()
-    // move all of the blocks to the right of the index left by one
-    for (unsigned long long i = index; i < size() - 1; i++) {
-      swap(i, i + 1);
-    }
-    siz--;
+    erase(index, index + 1);
     PC2L_DEBUG_STOP_TIMER("erase(" << index << ")")
-    // TODO: maybe some check to see if it is successfully deleted?
+  }
+
+  /**
+   * Erase the values in the index range [\p first, \p last). Values after
+   * the range are shifted left by the whole range at once, one block at
+   * a time.
+   * @param first index of the first value to be erased
+   * @param last index one past the last value to be erased
+   */
+  void erase(size_t first, size_t last) {
+    if (first > last || last > size()) {
+      throw PC2L_EXP("Cannot erase [%zu, %zu) (size is %llu)",
+                     "Ensure the range lies within the vector", first, last,
+                     size());
+    }
+    shiftValues(first, last, size() - last);
+    siz -= last - first;
+    trimZeroPages();
+  }
+
+  /**
+   * Erase the values in the range [\p first, \p last).
+   * @param first iterator to the first value to be erased
+   * @param last iterator one past the last value to be erased
+   * @return iterator to the value that followed the erased range
+   */
+  Iterator erase(const Iterator &first, const Iterator &last) {
+    erase(first.i, last.i);
+    return Iterator(*this, first.i);
   }
 
   /**
@@ -296,117 +731,132 @@ public:
    */
   T at(unsigned long long index) const {
     PC2L_DEBUG_START_TIMER()
-    // instead of div, prefer bitwise operations eventually
-    // but this will require moving to powers of 2 only
-
-    // For now we are hardcoding some of this to just test to see
-    // what is the performance improvement that we may be able to
-    // achieve with bitwise operations.
-
     auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
 
-    prefetch(inBlockIdx, blockTag);
-    if (blockTag == prevBlockTag) {
-      // if the CacheManager's cache contains this block, just get it
-      // get array of concatenated T-serializations
-      char *payload = prevMsg->getPayload();
-      return *reinterpret_cast<T *>(payload + inBlockIdx);
-    }
-    CacheManager &cm = System::get().cacheManager();
-    MessagePtr msg = cm.getBlockFallbackRemote(dsTag, blockTag);
-    prevBlockTag = blockTag;
-    prevMsg = msg;
-    // if the CacheManager's cache contains this block, just get it
+    prefetch(index);
     // get array of concatenated T-serializations
-    char *payload = msg->getPayload();
+    const char *payload = fetchBlock(blockTag)->getPayload();
     PC2L_DEBUG_STOP_TIMER("at(" << index << ")")
-    return *reinterpret_cast<T *>(payload + inBlockIdx);
+    return *reinterpret_cast<const T *>(payload + inBlockIdx);
   }
 
   T *ptr(unsigned long long index) {
     PC2L_DEBUG_START_TIMER()
-    // instead of div, prefer bitwise operations eventually
-    // but this will require moving to powers of 2 only
-
-    // For now we are hardcoding some of this to just test to see
-    // what is the performance improvement that we may be able to
-    // achieve with bitwise operations.
-
-    // const auto ret = std::lldiv(index*sizeof(T), BlockSize);
-    // const size_t blockTag = ret.quot;
-    // unsigned long long inBlockIdx = ret.rem;
-
-    // @insert: index = 99, blockTag = 12, inBlockIdx = 12
-    // @at: index = 99, blockTag = 49, inBlockIdx = 4
     auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
-    // std::cout << "@at: index = " << index << ", blockTag = " << blockTag
-    //           << ", inBlockIdx = " << inBlockIdx << std::endl;
 
-    prefetch(inBlockIdx, blockTag);
-    if (blockTag == prevBlockTag) {
-      // if the CacheManager's cache contains this block, just get it
-      // get array of concatenated T-serializations
-      char *payload = prevMsg->getPayload();
-      return reinterpret_cast<T *>(payload + inBlockIdx);
-    }
-    CacheManager &cm = System::get().cacheManager();
-    MessagePtr msg = cm.getBlockFallbackRemote(dsTag, blockTag);
-    prevBlockTag = blockTag;
-    prevMsg = msg;
-    // if the CacheManager's cache contains this block, just get it
+    prefetch(index);
     // get array of concatenated T-serializations
-    char *payload = msg->getPayload();
-    PC2L_DEBUG_STOP_TIMER("at(" << index << ")")
+    char *payload = fetchBlockForWrite(blockTag)->getPayload();
+    PC2L_DEBUG_STOP_TIMER("ptr(" << index << ")")
     return reinterpret_cast<T *>(payload + inBlockIdx);
   }
 
   /**
-   * Insert \p value at vector index \p index.
-   * @param index index where insert should occur
-   * @param value value to be inserted
+   * Copy \p count values starting at index \p first into \p out. All of
+   * the blocks touched by the range are worked out up front, the ones
+   * missing from the manager cache are requested from their workers in
+   * one pass, and whole block payloads are then copied into \p out.
+   * @param first index of the first value to be read
+   * @param count number of values to be read
+   * @param out buffer with room for at least \p count values
    */
-  void insert(unsigned long long index, T value) {
+  void read(size_t first, size_t count, T *out) const {
     PC2L_DEBUG_START_TIMER()
-    auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
-    CacheManager &cm = System::get().cacheManager();
-    bool isTail = index == size();
-
-    if (!isTail) {
-      // all other values shifted right one index (size incremented here)
-      // we have to do this BEFORE the (potentially evicted) message with
-      // this value in it is retrieved
-      insert(size(), at(size() - 1));
-      for (auto i = size() - 2; i > index; i--) {
-        replace(i, at(i - 1));
-      }
+    if (first + count > size()) {
+      throw PC2L_EXP("Cannot read %zu values from index %zu (size is %llu)",
+                     "Ensure the range lies within the vector", count, first,
+                     size());
     }
+    forEachBlock<false>(first, first + count,
+                        [&out](const T *values, size_t n) {
+                          out = std::copy_n(values, n, out);
+                        });
+    PC2L_DEBUG_STOP_TIMER("read(" << first << ", " << count << ")")
+  }
 
-    MessagePtr msg;
-    if (prevBlockTag == blockTag && size() > 0) {
-      // we already have this block in memory
-      msg = prevMsg;
-    } else if (isTail) {
-      // we're inserting at the tail, create a new block
-      msg =
-          Message::create(BlockSize, Message::STORE_BLOCK, 0, dsTag, blockTag);
-    } else {
-      // we don't have the block in memory, but it must be on a remote worker
-      msg = cm.getBlockFallbackRemote(dsTag, blockTag);
+  /**
+   * Copy the values in the range [\p first, \p last) to \p out. This is
+   * a convenience overload of read(size_t, size_t, T*) that stages at most
+   * one window of blocks at a time.
+   * @param first iterator to the first value to be read
+   * @param last iterator one past the last value to be read
+   * @param out output iterator to which the values are written
+   * @return output iterator one past the last value written
+   */
+  template <typename OutputIt>
+  OutputIt read(const Iterator &first, const Iterator &last,
+                OutputIt out) const {
+    const size_t chunk = fetchWindow() * BlockElementCount;
+    std::vector<T> buf;
+    for (size_t i = first.i; i < last.i; i += chunk) {
+      buf.resize(std::min(chunk, last.i - i));
+      read(i, buf.size(), buf.data());
+      out = std::copy(buf.begin(), buf.end(), out);
     }
+    return out;
+  }
 
-    char *block = msg->getPayload();
-    char *serialized = reinterpret_cast<char *>(&value);
-    std::move(&serialized[0], &serialized[sizeof(T)], &block[inBlockIdx]);
+  /**
+   * Call \p fn(const T *values, size_t count) once for each run of
+   * values in the index range [\p first, \p last) that is contiguous in
+   * memory, i.e., that lies within a single block. Blocks missing from
+   * the manager cache are fetched a window at a time (see read). If
+   * \p fn returns a bool, returning false stops the walk early.
+   * @param first index of the first value
+   * @param last index one past the last value
+   * @param fn callable that is given each run of values
+   */
+  template <typename Fn>
+  void for_each_segment(size_t first, size_t last, Fn fn) const {
+    forEachBlock<false>(first, last, fn);
+  }
 
-    // then put the object at retrieved index into cache
-    prevMsg = msg;
-    prevBlockTag = blockTag;
-    cm.storeCacheBlock(msg);
+  /**
+   * Call \p fn(T *values, size_t count) once for each run of values in
+   * the index range [\p first, \p last) that lies within a single block.
+   * The values may be changed in place: every block that is visited is
+   * marked dirty. If \p fn returns a bool, returning false stops the walk
+   * early.
+   * @param first index of the first value
+   * @param last index one past the last value
+   * @param fn callable that is given each run of values
+   */
+  template <typename Fn>
+  void for_each_segment(size_t first, size_t last, Fn fn) {
+    forEachBlock<true>(first, last, fn);
+  }
 
-    // for non-tail inserts, we already increment the size on line 392
-    if (isTail) {
-      siz++;
+  /**
+   * Pin the block holding the value at index \p index in the manager
+   * cache. While the lease is held the block is never evicted, so its
+   * values can be read and written in place without refetching the
+   * block, e.g., to work on a couple of rows of a matrix at once. The
+   * value at \p index is lease.values<T>()[index % BlockElementCount].
+   * Clearing or destroying the vector, or running an algorithm on the
+   * workers over it, invalidates the lease.
+   * @param index index of a value in the block to be pinned
+   * @return lease pinning the block
+   */
+  BlockLease lease(size_t index) {
+    if (index >= siz) {
+      throw PC2L_EXP("Cannot lease index %zu (size is %llu)",
+                     "Ensure the index lies within the vector", index, siz);
+    }
+    const size_t blockTag = index / BlockElementCount;
+    if (isZeroPage(blockTag)) {
+      materialize(blockTag);
     }
+    return BlockLease(fetchBlock(blockTag));
+  }
+
+  /**
+   * Insert \p value at vector index \p index.
+   * @param index index where insert should occur
+   * @param value value to be inserted
+   */
+  void insert(unsigned long long index, T value) {
+    PC2L_DEBUG_START_TIMER()
+    insert(index, &value, &value + 1);
     PC2L_DEBUG_STOP_TIMER("insert(" << index << ", " << value << ")")
   }
 
@@ -415,6 +865,102 @@ public:
     return Iterator(*this, index.i);
   }
 
+  /**
+   * Insert the values in the range [\p first, \p last) before index
+   * \p index. Values from \p index onwards are shifted right by the whole
+   * range at once, one block at a time. The range must not refer to this
+   * vector.
+   * @param index index where the first value should be inserted
+   * @param first iterator to the first value to be inserted
+   * @param last iterator one past the last value to be inserted
+   */
+  template <typename ForwardIt>
+  void insert(size_t index, ForwardIt first, ForwardIt last) {
+    if (index > size()) {
+      throw PC2L_EXP("Cannot insert at %zu (size is %llu)",
+                     "Ensure the index lies within the vector", index,
+                     size());
+    }
+    const size_t count = std::distance(first, last);
+    const size_t tail = size() - index;
+    if (tail == 0) {
+      appendBlocks(count, [&first](T *dst, size_t n) {
+        for (size_t i = 0; i < n; i++, ++first) {
+          new (dst + i) T(*first);
+        }
+      });
+      return;
+    }
+    // grow the vector, move the tail out of the way, then fill in the
+    // gap. The new slots are overwritten by the shift, but blocks may be
+    // written back before that, so they start out as copies of the
+    // first inserted value rather than as uninitialized bytes.
+    appendBlocks(count, [&first](T *dst, size_t n) {
+      std::uninitialized_fill_n(dst, n, T(*first));
+    });
+    shiftValues(index + count, index, tail);
+    for (size_t i = index; i < index + count;) {
+      const size_t blockTag = i / BlockElementCount;
+      const size_t n = std::min(index + count - i,
+                                (blockTag + 1) * BlockElementCount - i);
+      const MessagePtr &msg = fetchBlockForWrite(blockTag);
+      T *dst = reinterpret_cast<T *>(msg->getPayload()) +
+               (i % BlockElementCount);
+      for (size_t j = 0; j < n; j++, ++first) {
+        new (dst + j) T(*first);
+      }
+      System::get().cacheManager().storeCacheBlock(msg);
+      i += n;
+    }
+  }
+
+  /**
+   * Insert the values in the range [\p first, \p last) before \p pos.
+   * @param pos iterator to the position of the first inserted value
+   * @param first iterator to the first value to be inserted
+   * @param last iterator one past the last value to be inserted
+   * @return iterator to the first inserted value
+   */
+  template <typename ForwardIt>
+  Iterator insert(const Iterator &pos, ForwardIt first, ForwardIt last) {
+    insert(pos.i, first, last);
+    return Iterator(*this, pos.i);
+  }
+
+  /**
+   * Append \p n values from \p data to the end of the vector. Values are
+   * staged into whole blocks locally and each finished block is handed
+   * to the cache (or straight to its owning worker) once, instead of once
+   * per value as with push_back.
+   * @param data pointer to the values to be appended
+   * @param n number of values to be appended
+   */
+  void append(const T *data, size_t n) {
+    PC2L_DEBUG_START_TIMER()
+    appendBlocks(n, [&data](T *dst, size_t count) {
+      std::uninitialized_copy_n(data, count, dst);
+      data += count;
+    });
+    PC2L_DEBUG_STOP_TIMER("append(" << n << ")")
+  }
+
+  /**
+   * Replace the contents of the vector with the values in the range
+   * [\p first, \p last). The range must not refer to this vector. The
+   * old blocks are released first (see clear), so none of them outlives
+   * the new contents.
+   * @param first iterator to the first value to be copied
+   * @param last iterator one past the last value to be copied
+   */
+  template <typename ForwardIt> void assign(ForwardIt first, ForwardIt last) {
+    clear();
+    appendBlocks(std::distance(first, last), [&first](T *dst, size_t count) {
+      for (size_t i = 0; i < count; i++, ++first) {
+        new (dst + i) T(*first);
+      }
+    });
+  }
+
   /**
    * Alias for inserting at "back" (largest index) of vector
    * @param value value to be inserted
@@ -429,30 +975,110 @@ public:
   void replace(unsigned long long index, T value) {
     PC2L_DEBUG_START_TIMER()
     const auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
-    prefetch(inBlockIdx, blockTag);
-    MessagePtr msg;
-    CacheManager &cm = System::get().cacheManager();
-    if (blockTag == prevBlockTag) {
-      msg = prevMsg;
-    } else {
-      msg = cm.getBlockFallbackRemote(dsTag, blockTag);
-    }
+    prefetch(index);
+    const MessagePtr &msg = fetchBlockForWrite(blockTag);
     char *block = msg->getPayload();
     // fill the buffer with new datum at correct in-blok offset
     char *serialized = reinterpret_cast<char *>(&value);
     std::move(&serialized[0], &serialized[sizeof(T)], &block[inBlockIdx]);
-    prevMsg = msg;
-    prevBlockTag = blockTag;
-    cm.storeCacheBlock(msg);
+    System::get().cacheManager().storeCacheBlock(msg);
     PC2L_DEBUG_STOP_TIMER("replace(" << index << ", " << value << ")")
   }
 
   /**
-   * Sort vector in ascending order using mergesort
+   * Add \p delta to the value at \p index. Unlike at() followed by
+   * replace(), the block is not fetched when it is not in the manager
+   * cache: the worker that owns it applies the addition and only
+   * \p delta and the old value are sent over the network. Updates are
+   * applied one at a time by the process holding the block, so
+   * concurrent updates of the same value are never lost.
+   * @param index index of the value to be changed
+   * @param delta the value to be added
+   * @return the value before the addition
+   */
+  T fetch_add(size_t index, T delta) {
+    return apply(index, RegisteredUpdate<FetchAdd>::id, delta);
+  }
+
+  /**
+   * Replace the value at \p index with \p desired if it is equal to
+   * \p expected (bytewise), in one step on the process holding the
+   * block, as in fetch_add().
+   * @param index index of the value to be changed
+   * @param expected the value that is expected at \p index; set to the
+   * value found there if it is a different one
+   * @param desired the value to be stored
+   * @return true if the value was replaced
+   */
+  bool compare_exchange(size_t index, T &expected, T desired) {
+    const T operand[2] = {expected, desired};
+    const T old = apply(index, RegisteredUpdate<CompareExchange>::id, operand);
+    if (std::memcmp(&old, &expected, sizeof(T)) == 0) {
+      return true;
+    }
+    expected = old;
+    return false;
+  }
+
+  /**
+   * Apply a registered update to the value at \p index, on the process
+   * holding the block, as in fetch_add(). The update is a type U with a
+   * static method U::apply(char *value, const char *operand), registered
+   * by referring to RegisteredUpdate<U>::id.
+   * @param index index of the value to be changed
+   * @param updateId the id of the update
+   * @param operand the operand of the update, which is copied bytewise
+   * @return the value before the update
+   */
+  template <typename Operand>
+  T apply(size_t index, size_t updateId, const Operand &operand) {
+    static_assert(std::is_trivially_copyable_v<T> &&
+                      std::is_trivially_copyable_v<Operand>,
+                  "Values and operands of updates are copied bytewise");
+    const auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
+    if (isZeroPage(blockTag)) {
+      materialize(blockTag);
+    }
+    MessagePtr msg =
+        Message::create(sizeof(UpdateHeader) + sizeof(Operand),
+                        Message::UPDATE_ELEMENT, 0, dsTag, blockTag);
+    const UpdateHeader header{updateId, inBlockIdx, sizeof(T)};
+    std::memcpy(msg->getPayload(), &header, sizeof(header));
+    std::memcpy(msg->getPayload() + sizeof(header), &operand, sizeof(Operand));
+    T old;
+    System::get().cacheManager().updateBlock(msg, reinterpret_cast<char *>(&old));
+    return old;
+  }
+
+  /**
+   * Sort vector in ascending order using mergesort. This moves values
+   * one at a time through the manager; pc2l::sort (see Algorithm.h)
+   * sorts on the workers instead.
    */
   void sort() { mergesort(0, size() - 1); }
 
 private:
+  /** The update behind fetch_add() */
+  struct FetchAdd {
+    static void apply(char *value, const char *operand) {
+      T sum, delta;
+      std::memcpy(&sum, value, sizeof(T));
+      std::memcpy(&delta, operand, sizeof(T));
+      sum += delta;
+      std::memcpy(value, &sum, sizeof(T));
+    }
+  };
+
+  /** The update behind compare_exchange(), whose operand is the expected
+   * value followed by the desired one */
+  struct CompareExchange {
+    static void apply(char *value, const char *operand) {
+      if (std::memcmp(value, operand, sizeof(T)) == 0) {
+        std::memcpy(value, operand + sizeof(T), sizeof(T));
+      }
+    }
+  };
+
   /**
    * Calculate the block tag and position within a block where the item at
    * position \p index should be stored.
@@ -462,11 +1088,357 @@ private:
   const static std::tuple<size_t, size_t, size_t>
   indexCalculation(unsigned long long index) {
     const size_t offset = index * TypeSize;
-    const size_t blockTag = (offset >> BlockShiftBits),
-                 inBlockIdx = (offset & IndexMask);
+    // BlockElementCount is a compile-time constant, so these reduce to a
+    // shift and a mask whenever sizeof(T) is a power of 2
+    const size_t blockTag = index / BlockElementCount,
+                 inBlockIdx = (index % BlockElementCount) * TypeSize;
     return std::tie(offset, blockTag, inBlockIdx);
   }
 
+  /**
+   * Obtain the message containing block \p blockTag. The most recently
+   * retrieved block is reused as long as it is still in the manager
+   * cache, otherwise the block is fetched through the CacheManager (from
+   * the remote worker if necessary). Zero pages are served from the
+   * shared zero block, which must not be written to.
+   * @param blockTag the block tag of the block to be retrieved
+   * @return reference to the message containing the block
+   * @throws Exception if the block exists neither in the cache nor on
+   * its worker
+   */
+  const MessagePtr &fetchBlock(size_t blockTag) const {
+    if (isZeroPage(blockTag)) {
+      return zeroBlock();
+    }
+    if (blockTag != prevBlockTag || !prevMsg || !prevMsg->cached) {
+      CacheManager &cm = System::get().cacheManager();
+      prevMsg = cm.getBlockFallbackRemote(dsTag, blockTag);
+      prevBlockTag = blockTag;
+      if (!prevMsg) {
+        throw missingBlock(blockTag);
+      }
+    }
+    return prevMsg;
+  }
+
+  /**
+   * Create the exception thrown when a block of this vector exists
+   * neither in the manager cache nor on its worker, e.g., because the
+   * vector was used after its blocks were dropped.
+   * @param blockTag the block tag of the missing block
+   * @return the exception to be thrown
+   */
+  Exception missingBlock(size_t blockTag) const {
+    return PC2L_EXP("Block %zu of data structure %zu does not exist",
+                    "Ensure the vector was not cleared or moved from",
+                    blockTag, dsTag);
+  }
+
+  /**
+   * Walk the index range [\p first, \p last) a block at a time. The
+   * blocks are requested a window at a time, so that blocks missing from
+   * the manager cache are fetched from their workers concurrently.
+   * @tparam Write if true, the values are handed out as T* and each
+   * visited block is marked dirty, otherwise they are handed out as
+   * const T*
+   * @param first index of the first value
+   * @param last index one past the last value
+   * @param fn callable invoked as fn(values, count) for each block; if it
+   * returns a bool, returning false stops the walk
+   */
+  template <bool Write, typename Fn>
+  void forEachBlock(size_t first, size_t last, Fn &&fn) const {
+    if (first >= last) {
+      return;
+    }
+    CacheManager &cm = System::get().cacheManager();
+    const size_t endTag = (last - 1) / BlockElementCount + 1;
+    const size_t window = fetchWindow();
+    std::vector<size_t> tags;
+    for (size_t tag = first / BlockElementCount; tag < endTag; tag += window) {
+      const size_t windowEnd = std::min(tag + window, endTag);
+      // zero pages are not requested: they are read from the zero block,
+      // or materialized when they are going to be written
+      tags.clear();
+      for (size_t blockTag = tag; blockTag < windowEnd; blockTag++) {
+        if (isZeroPage(blockTag)) {
+          if constexpr (!Write) {
+            continue;
+          }
+          materialize(blockTag);
+        }
+        tags.push_back(blockTag);
+      }
+      const auto blocks = cm.getBlocksFallbackRemote(dsTag, tags);
+      for (size_t blockTag = tag, b = 0; blockTag < windowEnd; blockTag++) {
+        const size_t blockFirst = std::max(first, blockTag * BlockElementCount);
+        const size_t count =
+            std::min(last, (blockTag + 1) * BlockElementCount) - blockFirst;
+        const bool zero = (b == tags.size() || tags[b] != blockTag);
+        const MessagePtr &fetched = zero ? zeroBlock() : blocks[b++];
+        if (!fetched) {
+          throw missingBlock(blockTag);
+        }
+        // a block written to must still be the cached copy, while a stale
+        // copy is fine for reading
+        const MessagePtr &msg = (!Write || fetched->cached)
+                                    ? fetched
+                                    : fetchBlock(blockTag);
+        std::conditional_t<Write, T, const T> *values =
+            reinterpret_cast<T *>(msg->getPayload()) +
+            (blockFirst % BlockElementCount);
+        if constexpr (Write) {
+          msg->dirty = true;
+        }
+        if constexpr (std::is_same_v<decltype(fn(values, count)), bool>) {
+          if (!fn(values, count)) {
+            return;
+          }
+        } else {
+          fn(values, count);
+        }
+      }
+    }
+  }
+
+  /**
+   * Write \p value at \p index, marking its block dirty.
+   * @param index index of the value to be written
+   * @param value the value to be written
+   */
+  void write(size_t index, const T &value) {
+    const auto [offset, blockTag, inBlockIdx] = indexCalculation(index);
+    prefetch(index);
+    char *payload = fetchBlockForWrite(blockTag)->getPayload();
+    std::memcpy(payload + inBlockIdx, static_cast<const void *>(&value),
+                sizeof(T));
+  }
+
+  /**
+   * Obtain the message containing block \p blockTag in order to write
+   * to it. The block is marked dirty, so that it is sent back to its
+   * owning worker when it is evicted from the manager cache.
+   * @param blockTag the block tag of the block to be written
+   * @return reference to the message containing the block
+   */
+  const MessagePtr &fetchBlockForWrite(size_t blockTag) {
+    if (isZeroPage(blockTag)) {
+      materialize(blockTag);
+    }
+    const MessagePtr &msg = fetchBlock(blockTag);
+    msg->dirty = true;
+    return msg;
+  }
+
+  /**
+   * Grow the vector by \p n values, a block at a time. The tail block is
+   * topped up first, then new blocks are created and filled locally. Each
+   * block is stored exactly once: the final blocks are stored in the
+   * manager cache (as push_back would leave them) while earlier ones are
+   * sent directly to their owning workers.
+   * @param n number of values to be appended
+   * @param fill callable invoked as fill(T *dst, size_t count) to
+   * construct the next \p count values in the raw storage at \p dst
+   */
+  template <typename Fill> void appendBlocks(size_t n, Fill fill) {
+    CacheManager &cm = System::get().cacheManager();
+    const size_t window = fetchWindow();
+    stored = stored || n > 0;
+    while (n > 0) {
+      const size_t blockTag = siz / BlockElementCount;
+      const size_t inBlock = siz % BlockElementCount;
+      const size_t count = std::min<size_t>(n, BlockElementCount - inBlock);
+      // top up the existing tail block or start a fresh one
+      MessagePtr msg = (inBlock != 0) ? fetchBlockForWrite(blockTag)
+                                      : Message::create(BlockSize,
+                                                        Message::STORE_BLOCK,
+                                                        0, dsTag, blockTag);
+      fill(reinterpret_cast<T *>(msg->getPayload()) + inBlock, count);
+      siz += count;
+      n -= count;
+      // blocks that would be evicted before this append finishes go
+      // straight to their owner, unless the cache holds an older copy
+      if (n >= window * BlockElementCount &&
+          System::get().worldRank() == 0 &&
+          cm.getBlock(dsTag, blockTag, true) == nullptr) {
+        cm.send(msg, CacheWorker::getStoredRank(blockTag));
+      } else {
+        cm.storeCacheBlock(msg);
+      }
+      prevMsg = msg;
+      prevBlockTag = blockTag;
+    }
+  }
+
+  /**
+   * Append every value of \p other to this (empty) vector, copying
+   * whole block payloads. Starting empty keeps the blocks of both vectors
+   * lined up, so each fill corresponds to exactly one block of \p other,
+   * and the zero pages of \p other stay zero pages in this vector.
+   * @param other the vector whose values are to be appended
+   */
+  void appendFrom(const Vector &other) {
+    const auto copyUpTo = [&](size_t n) {
+      appendBlocks(n - siz, [&](T *dst, size_t count) {
+        const size_t blockTag = siz / BlockElementCount;
+        const char *src = other.fetchBlock(blockTag)->getPayload() +
+                          (siz % BlockElementCount) * TypeSize;
+        std::memcpy(static_cast<void *>(dst), src, count * TypeSize);
+      });
+    };
+    for (const auto &[begin, end] : other.zeroRuns) {
+      copyUpTo(begin * BlockElementCount);
+      resize(std::min<size_t>(end * BlockElementCount, other.size()));
+    }
+    copyUpTo(other.size());
+  }
+
+  /**
+   * Exchange the blocks (identified by the data structure tag) and the
+   * size of this vector with those of \p other.
+   * @param other the vector to exchange contents with
+   */
+  void swapContents(Vector &other) noexcept {
+    std::swap(dsTag, other.dsTag);
+    std::swap(siz, other.siz);
+    std::swap(prevBlockTag, other.prevBlockTag);
+    std::swap(prevMsg, other.prevMsg);
+    std::swap(stored, other.stored);
+    std::swap(prefetcher, other.prefetcher);
+    std::swap(zeroRuns, other.zeroRuns);
+    std::swap(reserved, other.reserved);
+  }
+
+  /**
+   * Check whether a block is a zero page, i.e., a block added by resize
+   * that has not been written to.
+   * @param blockTag the block tag of the block to be checked
+   * @return true if the block is a zero page
+   */
+  bool isZeroPage(size_t blockTag) const {
+    auto run = zeroRuns.upper_bound(blockTag);
+    return run != zeroRuns.begin() && blockTag < std::prev(run)->second;
+  }
+
+  /**
+   * Obtain the block of zeros that zero pages are read from. It is
+   * shared by all vectors with the same block size and is never cached,
+   * so writes go through fetchBlockForWrite, which materializes the zero
+   * page instead.
+   * @return the shared zero block
+   */
+  static const MessagePtr &zeroBlock() {
+    static const MessagePtr block = [] {
+      MessagePtr msg = Message::create(BlockSize, Message::STORE_BLOCK);
+      std::fill_n(msg->getPayload(), BlockSize, 0);
+      return msg;
+    }();
+    return block;
+  }
+
+  /**
+   * Turn a zero page into a real block of zeros in the manager cache.
+   * From there it is sent to its owning worker when it is evicted, like
+   * any other block that was written.
+   * @param blockTag the block tag of the zero page
+   */
+  void materialize(size_t blockTag) const {
+    storeZeroBlock(blockTag);
+    // split the run holding the zero page around it
+    auto run = std::prev(zeroRuns.upper_bound(blockTag));
+    const size_t end = run->second;
+    if (run->first == blockTag) {
+      zeroRuns.erase(run);
+    } else {
+      run->second = blockTag;
+    }
+    if (blockTag + 1 < end) {
+      zeroRuns.emplace(blockTag + 1, end);
+    }
+  }
+
+  /**
+   * Create a real block of zeros in the manager cache for a zero page,
+   * without updating the runs of zero pages.
+   * @param blockTag the block tag of the zero page
+   */
+  void storeZeroBlock(size_t blockTag) const {
+    MessagePtr msg = Message::create(BlockSize, Message::STORE_BLOCK, 0,
+                                     dsTag, blockTag);
+    std::fill_n(msg->getPayload(), BlockSize, 0);
+    System::get().cacheManager().storeCacheBlock(msg);
+    stored = true;
+  }
+
+  /**
+   * Forget zero pages past the end of the vector after it shrank, so that
+   * blocks appended later are not mistaken for zero pages.
+   */
+  void trimZeroPages() {
+    const size_t blockCount = (siz + BlockElementCount - 1) / BlockElementCount;
+    zeroRuns.erase(zeroRuns.lower_bound(blockCount), zeroRuns.end());
+    if (!zeroRuns.empty() && zeroRuns.rbegin()->second > blockCount) {
+      zeroRuns.rbegin()->second = blockCount;
+    }
+  }
+
+  /**
+   * Move \p count values starting at index \p from so that they start at
+   * index \p to. The source and destination ranges may overlap. Values
+   * are moved in chunks that lie within a single source block and a
+   * single destination block, so each block is fetched and stored once
+   * per chunk rather than once per value. The chunks are processed from
+   * the end when moving right and from the start when moving left so
+   * that no value is overwritten before it is moved.
+   * @param to index where the first value should end up
+   * @param from index of the first value to be moved
+   * @param count number of values to be moved
+   */
+  void shiftValues(size_t to, size_t from, size_t count) {
+    if (to == from || count == 0) {
+      return;
+    }
+    CacheManager &cm = System::get().cacheManager();
+    const bool right = to > from;
+    for (size_t done = 0; done < count;) {
+      const size_t left = count - done;
+      // first index of the chunk in the source and destination ranges
+      size_t src, dst, n;
+      if (right) {
+        const size_t srcEnd = from + left, dstEnd = to + left;
+        n = std::min({left, (srcEnd - 1) % BlockElementCount + 1,
+                      (dstEnd - 1) % BlockElementCount + 1});
+        src = srcEnd - n;
+        dst = dstEnd - n;
+      } else {
+        src = from + done;
+        dst = to + done;
+        n = std::min({left, BlockElementCount - src % BlockElementCount,
+                      BlockElementCount - dst % BlockElementCount});
+      }
+      // fetch the destination last so it is the most recently used
+      // block and is not evicted before we write to it
+      const MessagePtr srcMsg = fetchBlock(src / BlockElementCount);
+      const MessagePtr &dstMsg = fetchBlockForWrite(dst / BlockElementCount);
+      std::memmove(dstMsg->getPayload() + (dst % BlockElementCount) * TypeSize,
+                   srcMsg->getPayload() + (src % BlockElementCount) * TypeSize,
+                   n * TypeSize);
+      cm.storeCacheBlock(dstMsg);
+      done += n;
+    }
+  }
+
+  /**
+   * Number of blocks that bulk operations fetch in one pass. This is
+   * bounded by the number of blocks the manager cache can hold so that
+   * the memory staged by a single pass stays bounded too.
+   * @return number of blocks per pass (at least 1)
+   */
+  static size_t fetchWindow() {
+    const auto cacheSize = System::get().cacheManager().cacheSize;
+    return std::max<size_t>(1, cacheSize / (BlockSize + sizeof(Message)));
+  }
+
   // Merges the sorted and unsorted portions of the Vector
   void merge(int low, int mid, int high) {
     auto secondLow = mid + 1;
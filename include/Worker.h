@@ -59,6 +59,28 @@ BEGIN_NAMESPACE(pc2l);
  */
 class Worker {
 public:
+  /**
+   * The MPI tags with which messages are sent to workers (i.e., to
+   * ranks other than the manager). Workers keep receives for them
+   * posted ahead of time (see CacheWorker::run), so the tag of the
+   * message itself only travels in its header.
+   */
+  enum RingTag : int {
+    CONTROL_TAG = 0x100, /**< Messages up to ControlSlotSize bytes, or
+                            the header of a larger message */
+    BLOCK_TAG,           /**< Messages of up to BlockSlotSize bytes whose
+                            header was sent with CONTROL_TAG */
+    LARGE_TAG            /**< Larger messages whose header was sent with
+                            CONTROL_TAG */
+  };
+
+  /** The largest message that a worker receives in a single part */
+  static constexpr int ControlSlotSize = 512;
+
+  /** The largest message whose second part is received into a buffer
+      that a worker posts ahead of time */
+  static constexpr int BlockSlotSize = 64 * 1024;
+
   /**
    * The required polymorphic destructor for the worker class.
    */
@@ -112,14 +134,31 @@ public:
    * \param[in] destRank The destination rank to where the message
    * is to be sent.
    */
-  void send(MessagePtr msgPtr, const int destRank = 0);
+  virtual void send(MessagePtr msgPtr, const int destRank = 0);
+
+  /**
+   * Start sending a message without waiting for it to be received.
+   * Like send, a message to a worker is split as described in
+   * RingTag; the header of a large message is sent before this
+   * method returns.
+   *
+   * \param[in] msgPtr Pointer to the message to be sent. The message
+   * must not be changed or released until the send has completed.
+   *
+   * \param[in] destRank The destination rank to where the message
+   * is to be sent.
+   *
+   * \return The request to complete (e.g., via MPI_Wait) the send.
+   */
+  MPI_Request startSend(const MessagePtr &msgPtr, const int destRank);
 
   /**
    * Waits on a request to come back then returns pointer to data with result
    * @param req MPI_Request to wait on
-   * @return resulting message
+   * @param buffer the buffer the request receives into
+   * @return resulting message, which resides in \p buffer
    */
-  MessagePtr wait(MPI_Request req);
+  MessagePtr wait(MPI_Request &req, std::vector<char> &buffer);
 
   /**
    * Helper method to receive a message (binary blob), optionaly
@@ -145,6 +184,10 @@ public:
    * method ensures that it has concluded, and it must
    * be passed the MPI_Request from this method
    *
+   * \param[in] buffer The buffer to receive the message into. The
+   * size of the message is not known up front, so the buffer must be
+   * large enough to hold the largest message that can match.
+   *
    * \param[in] srcRank The rank from where a message must be
    * received.  If this parameter is \c MPI_ANY_SOURCE, then the
    * first revived message is typically returned.
@@ -155,7 +198,8 @@ public:
    *
    * \return Request resulting from recv
    */
-  MPI_Request startReceiveNonblocking(const int srcRank = MPI_ANY_SOURCE,
+  MPI_Request startReceiveNonblocking(std::vector<char> &buffer,
+                                      const int srcRank = MPI_ANY_SOURCE,
                                       const int tag = MPI_ANY_TAG);
 
 protected:
@@ -166,15 +210,6 @@ protected:
    *
    */
   Worker() {}
-
-private:
-  /**
-   * A reused buffer that is used to receive messages. This buffer
-   * is reused to minimize the memory allocation overheads and
-   * possibly improve CPU-caching.
-   *
-   */
-  std::vector<char> recvBuf;
 };
 
 END_NAMESPACE(pc2l);
@@ -66,5 +66,7 @@
 #include "ArgParser.h"
 #include "System.h"
 #include "Vector.h"
+#include "SparseVector.h"
+#include "Algorithm.h"
 
 #endif
@@ -39,13 +39,28 @@
 #include "CacheManager.h"
 #include "Exception.h"
 #include "MPIHelper.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
 #include <mpi.h>
 #include <thread>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
 
+void CacheManager::initialize() { running = true; }
+
 void CacheManager::finalize() {
+  stopProgressThread();
+  drainPrefetches();
+  for (int rank = 1; rank < MPI_GET_SIZE(); rank++) {
+    sendPendingStores(rank);
+  }
+  MPI_Waitall(writeBackReqs.size(), writeBackReqs.data(), MPI_STATUSES_IGNORE);
+  writeBackReqs.clear();
+  writeBacks.clear();
+  writeBackBytes = 0;
+  running = false;
   const auto workers = MPI_GET_SIZE();
   auto finMsg = Message::create(0, Message::FINISH);
   // Send finish message to all of the worker-processes
@@ -62,12 +77,6 @@ void CacheManager::finalize() {
 }
 
 MessagePtr CacheManager::getBlock(size_t dsTag, size_t blockTag, bool debug) {
-  // see if this is something we've prefetched. if so, just wait on the request
-  if (prefetchMsg != nullptr && dsTag == prefetchMsg->dsTag &&
-      blockTag == prefetchMsg->dsTag) {
-    // ask worker to wait on the result then return it
-    return wait(prefetchReq);
-  }
   size_t key = Message::getKey(dsTag, blockTag);
   PC2L_PROFILE(if (!debug) accesses++;)
   if (auto entry = getFromCache(key); entry->tag != Message::BLOCK_NOT_FOUND) {
@@ -81,18 +90,39 @@ MessagePtr CacheManager::getBlock(size_t dsTag, size_t blockTag, bool debug) {
 }
 
 MessagePtr CacheManager::getBlockFallbackRemote(size_t dsTag, size_t blockTag) {
+  const auto mpiGuard = lockMpi();
   MessagePtr ret = getBlock(dsTag, blockTag);
+  if (ret == nullptr && !inFlight.empty()) {
+    // the block may be on its way already, in which case we wait for it
+    // rather than asking for it again
+    progressPrefetches();
+    if (const auto slot = inFlight.find(Message::getKey(dsTag, blockTag));
+        slot != inFlight.end()) {
+      completePrefetch(slot->second);
+    }
+    ret = getBlock(dsTag, blockTag);
+  }
+  if (ret == nullptr) {
+    // a block that is being written back is served from its buffer
+    ret = reinstateWriteBack(dsTag, blockTag);
+  }
   if (ret == nullptr) {
     // otherwise, we have to get it from a remote cacheworker
     // if we're in profiling mode, note this
     if (System::get().profile) {
       std::cout << "miss," << dsTag << ',' << blockTag << std::endl;
     }
-    const unsigned long long worldSize = System::get().worldSize();
-    const int storedRank = (blockTag % (worldSize - 1)) + 1;
+    const int storedRank = getStoredRank(blockTag);
     ret = Message::create(0, Message::GET_BLOCK, 0, dsTag, blockTag);
     send(ret, storedRank);
     ret = recv(storedRank);
+    if (ret->tag == Message::BLOCK_NOT_FOUND) {
+      return nullptr;
+    }
+    // the block matches the worker's copy until it is written again, and
+    // any pins in the header were the ones of a copy sent earlier
+    ret->dirty = false;
+    ret->pins = 0;
     // then put the object at retrieved index into cache
     storeCacheBlock(ret);
   }
@@ -101,18 +131,530 @@ MessagePtr CacheManager::getBlockFallbackRemote(size_t dsTag, size_t blockTag) {
   return entry;
 }
 
-void CacheManager::getRemoteBlockNonblocking(size_t dsTag, size_t blockTag) {
-  const unsigned long long worldSize = System::get().worldSize();
-  const int storedRank = (blockTag % (worldSize - 1)) + 1;
-  MessagePtr reqMsg =
-      Message::create(0, Message::GET_BLOCK, 0, dsTag, blockTag);
-  send(reqMsg, storedRank);
-  // do a non-blocking receive call and store the request as a member
-  prefetchReq = startReceiveNonblocking(storedRank);
+std::vector<MessagePtr>
+CacheManager::getBlocksFallbackRemote(size_t dsTag,
+                                      const std::vector<size_t> &blockTags) {
+  const auto mpiGuard = lockMpi();
+  std::vector<MessagePtr> ret(blockTags.size());
+  // Indices (into blockTags) of the blocks that must come from workers
+  std::vector<size_t> misses;
+  progressPrefetches();
+  for (size_t i = 0; i < blockTags.size(); i++) {
+    if (const auto slot = inFlight.find(Message::getKey(dsTag, blockTags[i]));
+        slot != inFlight.end()) {
+      completePrefetch(slot->second);
+    }
+    ret[i] = getBlock(dsTag, blockTags[i]);
+    if (ret[i] == nullptr) {
+      ret[i] = reinstateWriteBack(dsTag, blockTags[i]);
+    }
+    if (ret[i] == nullptr) {
+      misses.push_back(i);
+    }
+  }
+  // Coalesce the requests per worker, so that each worker is sent one
+  // request (GET_BLOCKS if it owns several of the blocks) and answers
+  // with as few messages as the sizes of the blocks allow, and issue
+  // them all up front so that the workers serve them while we are still
+  // waiting on earlier replies
+  std::map<int, std::vector<size_t>> missesByRank;
+  for (const auto i : misses) {
+    if (System::get().profile) {
+      std::cout << "miss," << dsTag << ',' << blockTags[i] << std::endl;
+    }
+    missesByRank[getStoredRank(blockTags[i])].push_back(i);
+  }
+  for (const auto &[rank, indices] : missesByRank) {
+    if (indices.size() == 1) {
+      send(Message::create(0, Message::GET_BLOCK, 0, dsTag,
+                           blockTags[indices.front()]),
+           rank);
+      continue;
+    }
+    MessagePtr request = Message::create(indices.size() * sizeof(size_t),
+                                         Message::GET_BLOCKS, 0, dsTag, 0);
+    for (size_t r = 0; r < indices.size(); r++) {
+      const size_t key = Message::getKey(dsTag, blockTags[indices[r]]);
+      std::memcpy(request->getPayload() + r * sizeof(size_t), &key,
+                  sizeof(key));
+    }
+    send(request, rank);
+  }
+  for (const auto &[rank, indices] : missesByRank) {
+    // the reply is split into several batches (or single blocks) when
+    // the blocks do not fit into one
+    for (size_t r = 0; r < indices.size();) {
+      MessagePtr reply = recv(rank);
+      const std::vector<MessagePtr> blocks =
+          (reply->tag == Message::STORE_BLOCKS)
+              ? Message::unpackBatch(reply)
+              : std::vector<MessagePtr>{reply};
+      for (const MessagePtr &msg : blocks) {
+        const size_t index = indices[r++];
+        if (msg->tag == Message::BLOCK_NOT_FOUND) {
+          continue;
+        }
+        msg->dirty = false;
+        msg->pins = 0;
+        storeCacheBlock(msg);
+        ret[index] = getFromCache(msg->key);
+      }
+    }
+  }
+  return ret;
+}
+
+bool CacheManager::prefetchBlock(size_t dsTag, size_t blockTag,
+                                 int blockSize) {
+  const auto mpiGuard = lockMpi();
+  const size_t key = Message::getKey(dsTag, blockTag);
+  if (!running || inFlight.count(key) != 0 ||
+      getFromCache(key)->tag != Message::BLOCK_NOT_FOUND ||
+      reinstateWriteBack(dsTag, blockTag) != nullptr) {
+    return running;
+  }
+  auto freeSlot =
+      std::find(prefetchReqs.begin(), prefetchReqs.end(), MPI_REQUEST_NULL);
+  if (freeSlot == prefetchReqs.end()) {
+    // make room by installing the blocks that have arrived already
+    progressPrefetches();
+    freeSlot =
+        std::find(prefetchReqs.begin(), prefetchReqs.end(), MPI_REQUEST_NULL);
+    if (freeSlot == prefetchReqs.end()) {
+      return false;
+    }
+  }
+  const int slot = static_cast<int>(freeSlot - prefetchReqs.begin());
+  const int storedRank = getStoredRank(blockTag);
+  // The receive is posted before the request is sent, so the reply is
+  // matched to it (and can not be picked up by a blocking recv) however
+  // early it arrives. The worker answers in order, so replies to
+  // requests sent later are not matched to this receive.
+  prefetchBufs[slot].resize(blockSize);
+  prefetchReqs[slot] =
+      startReceiveNonblocking(prefetchBufs[slot], storedRank);
+  send(Message::create(0, Message::GET_BLOCK, 0, dsTag, blockTag), storedRank);
+  inFlight[key] = slot;
+  wakeProgress();
+  return true;
+}
+
+bool CacheManager::probeBlock(size_t dsTag, size_t blockTag) {
+  const auto mpiGuard = lockMpi();
+  if (getBlock(dsTag, blockTag, true) != nullptr) {
+    return true;
+  }
+  if (!running) {
+    return false;
+  }
+  // a block that is on its way exists unless the reply says otherwise
+  if (const auto slot = inFlight.find(Message::getKey(dsTag, blockTag));
+      slot != inFlight.end()) {
+    completePrefetch(slot->second);
+    return getBlock(dsTag, blockTag, true) != nullptr;
+  }
+  const int storedRank = getStoredRank(blockTag);
+  send(Message::create(0, Message::PROBE_BLOCK, 0, dsTag, blockTag),
+       storedRank);
+  return recv(storedRank)->tag == Message::PROBE_BLOCK;
+}
+
+void CacheManager::updateBlock(const MessagePtr &msg, char *old) {
+  const auto mpiGuard = lockMpi();
+  // a block on its way would overwrite the update when it is installed,
+  // so it is installed first and then updated here
+  if (const auto slot = inFlight.find(msg->key); slot != inFlight.end()) {
+    completePrefetch(slot->second);
+  }
+  MessagePtr block = getBlock(msg->dsTag, msg->blockTag);
+  if (block == nullptr) {
+    block = reinstateWriteBack(msg->dsTag, msg->blockTag);
+  }
+  if (block != nullptr) {
+    applyUpdate(block, msg->getPayload(), old);
+    block->dirty = true;
+    return;
+  }
+  MessagePtr reply;
+  if (running) {
+    const int storedRank = getStoredRank(msg->blockTag);
+    send(msg, storedRank);
+    reply = recv(storedRank);
+  }
+  if (reply == nullptr || reply->tag == Message::BLOCK_NOT_FOUND) {
+    throw PC2L_EXP("Block %u of data structure %u does not exist",
+                   "Updates must refer to values that have been stored",
+                   msg->blockTag, msg->dsTag);
+  }
+  std::memcpy(old, reply->getPayload(), reply->getPayloadSize());
+}
+
+void CacheManager::progressPrefetches() {
+  const auto mpiGuard = lockMpi();
+  if (inFlight.empty()) {
+    return;
+  }
+  int completed = 0;
+  MPI_Testsome(PrefetchSlots, prefetchReqs.data(), &completed,
+               completedSlots.data(), MPI_STATUSES_IGNORE);
+  for (int i = 0; (completed != MPI_UNDEFINED) && (i < completed); i++) {
+    installPrefetch(completedSlots[i]);
+  }
+}
+
+void CacheManager::drainPrefetches() {
+  const auto mpiGuard = lockMpi();
+  while (!inFlight.empty()) {
+    completePrefetch(inFlight.begin()->second);
+  }
+}
+
+void CacheManager::completePrefetch(int slot) {
+  MPI_Wait(&prefetchReqs[slot], MPI_STATUS_IGNORE);
+  installPrefetch(slot);
+}
+
+void CacheManager::installPrefetch(int slot) {
+  // storeCacheBlock copies the block out of the receive buffer
+  MessagePtr msg = Message::create(prefetchBufs[slot].data());
+  inFlight.erase(msg->key);
+  if (msg->tag == Message::BLOCK_NOT_FOUND) {
+    return;
+  }
+  msg->dirty = false;
+  msg->pins = 0;
+  storeCacheBlock(msg);
+}
+
+void CacheManager::pinBlock(const MessagePtr &block) {
+  if (!tryPinBlock(block)) {
+    throw PC2L_EXP("Cannot pin block %u of data structure %u: %llu of "
+                   "%llu bytes are pinned already",
+                   "Release a lease before taking another one",
+                   block->blockTag, block->dsTag, pinnedBytes, cacheSize / 2);
+  }
+}
+
+bool CacheManager::tryPinBlock(const MessagePtr &block) noexcept {
+  if (block->pins == 0) {
+    const auto blockBytes = static_cast<unsigned long long>(block->getSize());
+    if (pinnedBytes + blockBytes > cacheSize / 2) {
+      return false;
+    }
+    pinnedBytes += blockBytes;
+  }
+  block->pins++;
+  return true;
+}
+
+void CacheManager::unpinBlock(const MessagePtr &block) noexcept {
+  if (block->pins > 0 && --block->pins == 0) {
+    pinnedBytes -= block->getSize();
+  }
+}
+
+void CacheManager::dropDataStructure(size_t dsTag) {
+  const auto mpiGuard = lockMpi();
+  // blocks still in flight would otherwise land in the cache afterwards
+  drainPrefetches();
+  invalidatePins(dsTag);
+  currentBytes -= eraseDsFromCache(dsTag);
+  for (auto &[rank, blocks] : pendingStores) {
+    for (const auto &block : blocks) {
+      if (block->dsTag == dsTag) {
+        writeBackBytes -= block->getSize();
+      }
+    }
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [dsTag](const MessagePtr &block) {
+                                  return block->dsTag == dsTag;
+                                }),
+                 blocks.end());
+  }
+  forgetWriteBacks(dsTag);
+  if (running) {
+    auto dropMsg = Message::create(0, Message::DROP_DS, 0, dsTag, 0);
+    for (int rank = 1; rank < System::get().worldSize(); rank++) {
+      send(dropMsg, rank);
+    }
+  }
+}
+
+void CacheManager::flushDataStructure(size_t dsTag, size_t blockCount) {
+  const auto mpiGuard = lockMpi();
+  drainPrefetches();
+  for (size_t blockTag = 0; blockTag < blockCount; blockTag++) {
+    if (auto entry = getFromCache(Message::getKey(dsTag, blockTag));
+        entry->tag != Message::BLOCK_NOT_FOUND && entry->dirty) {
+      writeBackBlock(entry);
+    }
+  }
+  for (int rank = 1; rank < System::get().worldSize(); rank++) {
+    sendPendingStores(rank);
+  }
+  // the workers may change the blocks from here on, so the copies that
+  // are being sent must not be reinstated
+  forgetWriteBacks(dsTag);
+  invalidatePins(dsTag);
+  currentBytes -= eraseDsFromCache(dsTag);
+}
+
+void CacheManager::invalidatePins(size_t dsTag) {
+  for (const auto &block : getDsFromCache(dsTag)) {
+    if (block->pins > 0) {
+      pinnedBytes -= block->getSize();
+      block->pins = 0;
+    }
+  }
+}
+
+void CacheManager::send(MessagePtr msgPtr, const int destRank) {
+  const auto mpiGuard = lockMpi();
+  if (auto pending = pendingStores.find(destRank);
+      msgPtr && pending != pendingStores.end() && !pending->second.empty()) {
+    // requests for blocks only have to wait for the blocks they ask for;
+    // anything else (kernels in particular) may refer to any block
+    std::vector<size_t> keys;
+    if (msgPtr->tag == Message::GET_BLOCK) {
+      keys.push_back(msgPtr->key);
+    } else if (msgPtr->tag == Message::GET_BLOCKS) {
+      keys.resize(msgPtr->getPayloadSize() / sizeof(size_t));
+      std::memcpy(keys.data(), msgPtr->getPayload(),
+                  keys.size() * sizeof(size_t));
+    }
+    const bool requested =
+        keys.empty() ||
+        std::any_of(pending->second.begin(), pending->second.end(),
+                    [&keys](const MessagePtr &block) {
+                      return std::find(keys.begin(), keys.end(), block->key) !=
+                             keys.end();
+                    });
+    if (requested) {
+      sendPendingStores(destRank);
+    }
+  }
+  Worker::send(msgPtr, destRank);
+}
+
+void CacheManager::writeBackBlock(const MessagePtr &block) {
+  const auto mpiGuard = lockMpi();
+  if (!running) {
+    // without workers there is nowhere to write the block back to
+    return;
+  }
+  const int rank = getStoredRank(block->blockTag);
+  auto &blocks = pendingStores[rank];
+  blocks.push_back(block);
+  writeBackBytes += block->getSize();
+  if (blocks.size() >= StoreBatchSize) {
+    sendPendingStores(rank);
+  }
+  retireWriteBacks(false);
+  if (writeBackBytes > (writeBackLimit != 0 ? writeBackLimit : cacheSize)) {
+    // blocks held back can not complete, so send them all before waiting
+    for (auto &[pendingRank, pendingBlocks] : pendingStores) {
+      sendPendingStores(pendingRank);
+    }
+    retireWriteBacks(true);
+  }
+}
+
+void CacheManager::sendPendingStores(int rank) {
+  auto pending = pendingStores.find(rank);
+  if (pending == pendingStores.end() || pending->second.empty()) {
+    return;
+  }
+  std::vector<MessagePtr> blocks;
+  blocks.swap(pending->second);
+  // large blocks may not fit into a single batch
+  for (auto &batch : Message::splitBatches(blocks)) {
+    WriteBack writeBack;
+    writeBack.blocks.swap(batch);
+    // a single block is sent as is, which spares the worker a copy
+    writeBack.msg =
+        (writeBack.blocks.size() == 1)
+            ? writeBack.blocks.front()
+            : Message::createBatch(Message::STORE_BLOCKS, writeBack.blocks);
+    writeBackReqs.push_back(startSend(writeBack.msg, rank));
+    writeBacks.push_back(std::move(writeBack));
+  }
+  wakeProgress();
+}
+
+void CacheManager::progressWriteBacks() {
+  const auto mpiGuard = lockMpi();
+  retireWriteBacks(false);
+}
+
+void CacheManager::retireWriteBacks(bool wait) {
+  const unsigned long long limit =
+      (writeBackLimit != 0) ? writeBackLimit : cacheSize;
+  std::vector<int> done(writeBackReqs.size());
+  while (!writeBackReqs.empty()) {
+    int completed = 0;
+    if (wait && writeBackBytes > limit) {
+      MPI_Waitsome(writeBackReqs.size(), writeBackReqs.data(), &completed,
+                   done.data(), MPI_STATUSES_IGNORE);
+    } else {
+      MPI_Testsome(writeBackReqs.size(), writeBackReqs.data(), &completed,
+                   done.data(), MPI_STATUSES_IGNORE);
+    }
+    if (completed == 0 || completed == MPI_UNDEFINED) {
+      break;
+    }
+    // completed requests are set to MPI_REQUEST_NULL, so drop them
+    for (int i = 0; i < completed; i++) {
+      for (const auto &block : writeBacks[done[i]].blocks) {
+        writeBackBytes -= block->getSize();
+      }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < writeBackReqs.size(); i++) {
+      if (writeBackReqs[i] != MPI_REQUEST_NULL) {
+        writeBackReqs[kept] = writeBackReqs[i];
+        writeBacks[kept++] = std::move(writeBacks[i]);
+      }
+    }
+    writeBackReqs.resize(kept);
+    writeBacks.resize(kept);
+    if (!wait || writeBackBytes <= limit) {
+      break;
+    }
+  }
+}
+
+void CacheManager::forgetWriteBacks(size_t dsTag) {
+  // the buffers stay with their sends, only the blocks are dropped
+  for (auto &writeBack : writeBacks) {
+    auto &blocks = writeBack.blocks;
+    for (const auto &block : blocks) {
+      if (block->dsTag == dsTag) {
+        writeBackBytes -= block->getSize();
+      }
+    }
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [dsTag](const MessagePtr &block) {
+                                  return block->dsTag == dsTag;
+                                }),
+                 blocks.end());
+  }
+}
+
+MessagePtr CacheManager::reinstateWriteBack(size_t dsTag, size_t blockTag) {
+  if (writeBackBytes == 0) {
+    return nullptr;
+  }
+  const size_t key = Message::getKey(dsTag, blockTag);
+  const int rank = getStoredRank(blockTag);
+  if (auto pending = pendingStores.find(rank);
+      pending != pendingStores.end() &&
+      std::any_of(pending->second.begin(), pending->second.end(),
+                  [key](const MessagePtr &block) { return block->key == key; })) {
+    sendPendingStores(rank);
+  }
+  // a block may be evicted more than once before its sends complete, so
+  // the latest write-back holds its current data
+  for (auto writeBack = writeBacks.rbegin(); writeBack != writeBacks.rend();
+       writeBack++) {
+    for (const auto &block : writeBack->blocks) {
+      if (block->key != key) {
+        continue;
+      }
+      // MPI may still be reading a block that is sent on its own, so it
+      // is copied rather than handed out
+      MessagePtr reinstated =
+          (block == writeBack->msg) ? Message::create(*block) : block;
+      reinstated->dirty = false;
+      storeCacheBlock(reinstated);
+      return getFromCache(key);
+    }
+  }
+  return nullptr;
+}
+
+std::vector<MessagePtr> CacheManager::getDirtyBlocks(size_t dsTag) {
+  std::vector<MessagePtr> blocks = getDsFromCache(dsTag);
+  blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                              [](const MessagePtr &block) {
+                                return !block->dirty;
+                              }),
+               blocks.end());
+  return blocks;
+}
+
+void CacheManager::launchKernel(const MessagePtr &msg) {
+  const auto mpiGuard = lockMpi();
+  // kernels may exchange messages with the manager, which must not be
+  // mistaken for block replies
+  drainPrefetches();
+  for (int rank = 1; rank < System::get().worldSize(); rank++) {
+    send(msg, rank);
+  }
+  runKernel(msg);
 }
 
 void CacheManager::run() {
-  // bgWorker = std::thread(CacheManager::runBackgroundWorker);
+  int provided;
+  MPI_Query_thread(&provided);
+  if (useProgressThread && provided >= MPI_THREAD_SERIALIZED) {
+    stopProgress = false;
+    progressThread = std::thread(&CacheManager::progress, this);
+  }
+}
+
+void CacheManager::progress() {
+  while (!stopProgress) {
+    bool idle = false;
+    {
+      // the application thread has priority, so this thread only goes
+      // ahead while the application is outside the manager
+      std::unique_lock<std::recursive_mutex> guard(mpiLock, std::try_to_lock);
+      if (guard) {
+        int done;
+        for (MPI_Request &req : prefetchReqs) {
+          if (req != MPI_REQUEST_NULL) {
+            MPI_Request_get_status(req, &done, MPI_STATUS_IGNORE);
+          }
+        }
+        retireWriteBacks(false);
+        // requests are only started with mpiLock held, so clearing the
+        // flag here can not lose a wake-up
+        idle = inFlight.empty() && writeBackReqs.empty();
+        if (idle) {
+          std::lock_guard<std::mutex> workGuard(progressLock);
+          progressWork = false;
+        }
+      }
+    }
+    if (idle) {
+      std::unique_lock<std::mutex> workGuard(progressLock);
+      progressReady.wait(workGuard,
+                         [this] { return progressWork || stopProgress; });
+    } else {
+      std::this_thread::sleep_for(ProgressInterval);
+    }
+  }
+}
+
+void CacheManager::wakeProgress() {
+  if (progressThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> workGuard(progressLock);
+      progressWork = true;
+    }
+    progressReady.notify_one();
+  }
+}
+
+void CacheManager::stopProgressThread() noexcept {
+  if (progressThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> workGuard(progressLock);
+      stopProgress = true;
+    }
+    progressReady.notify_one();
+    progressThread.join();
+  }
 }
 
 END_NAMESPACE(pc2l);
@@ -39,6 +39,17 @@
 
 #include "CacheWorker.h"
 #include "Exception.h"
+#include "Kernel.h"
+#include "MessagePool.h"
+#include "System.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <cstring>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
@@ -49,31 +60,457 @@ CacheWorker::CacheWorker() {
   blockNotFoundMsg = Message::create(0, Message::BLOCK_NOT_FOUND);
 }
 
+// The sequence number of the reply that the executor running on this
+// thread owes for the request it is serving, or -1 if it owes none
+static thread_local long long replySeq = -1;
+
+class CacheWorker::Executors {
+public:
+  /** The method of CacheWorker that serves a request */
+  using Handler = void (CacheWorker::*)(const MessagePtr &);
+
+  /**
+   * Start one executor thread per shard of a worker's cache.
+   * \param[in] worker the worker whose requests are served
+   */
+  explicit Executors(CacheWorker &worker)
+      : worker(worker), queues(worker.getShardCount()) {
+    worker.executors = this;
+    for (auto &queue : queues) {
+      queue.thread = std::thread(&Executors::serveQueue, this, std::ref(queue));
+    }
+  }
+
+  /**
+   * Serve the requests that are still queued and stop the threads.
+   */
+  ~Executors() {
+    for (auto &queue : queues) {
+      {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.stopping = true;
+      }
+      queue.ready.notify_one();
+    }
+    for (auto &queue : queues) {
+      queue.thread.join();
+    }
+    worker.executors = nullptr;
+  }
+
+  /**
+   * Queue a request for the executor of the shard holding its block.
+   * \param[in] handler the method that serves the request
+   * \param[in] msg the request (or a block to be stored)
+   * \param[in] batch the message msg resides in, if any, which is kept
+   * until the request has been served
+   * \param[in] replies true if the handler sends exactly one reply
+   */
+  void dispatch(Handler handler, const MessagePtr &msg,
+                const MessagePtr &batch, bool replies) {
+    Queue &queue = queues[worker.getShard(msg->key)];
+    pending++;
+    {
+      std::lock_guard<std::mutex> guard(queue.lock);
+      queue.tasks.push_back({handler, msg, batch, replies ? nextSeq++ : -1});
+    }
+    queue.ready.notify_one();
+  }
+
+  /**
+   * Hand over the reply sent by an executor.
+   * \param[in] seq the sequence number of the reply
+   * \param[in] msg the reply
+   * \param[in] destRank the rank the reply is sent to
+   */
+  void postReply(long long seq, MessagePtr msg, int destRank) {
+    {
+      std::lock_guard<std::mutex> guard(outboxLock);
+      outbox.emplace(seq, std::make_pair(std::move(msg), destRank));
+    }
+    replied.notify_one();
+  }
+
+  /**
+   * Wait until the next reply to be sent has been handed over.
+   * \param[in] timeout the longest time to wait
+   */
+  void awaitReply(std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> guard(outboxLock);
+    replied.wait_for(guard, timeout, [this] {
+      return !outbox.empty() && outbox.begin()->first == sentSeq;
+    });
+  }
+
+  /**
+   * Check whether all requests dispatched so far have been served and
+   * their replies sent.
+   * \return true if no reply is owed
+   */
+  bool drained() {
+    // Executors post their reply before decrementing pending
+    if (pending != 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> guard(outboxLock);
+    return outbox.empty();
+  }
+
+  /**
+   * Send the replies handed over so far, as long as the replies to
+   * earlier requests have been sent.
+   */
+  void sendReplies() {
+    std::lock_guard<std::mutex> guard(outboxLock);
+    for (auto next = outbox.begin();
+         next != outbox.end() && next->first == sentSeq;
+         next = outbox.erase(next), sentSeq++) {
+      worker.send(next->second.first, next->second.second);
+    }
+  }
+
+  /**
+   * Wait until all requests dispatched so far have been served.
+   */
+  void quiesce() {
+    std::unique_lock<std::mutex> guard(idleLock);
+    idle.wait(guard, [this] { return pending == 0; });
+  }
+
+private:
+  /** A request queued for an executor */
+  struct Task {
+    Handler handler;
+    MessagePtr msg;
+    MessagePtr batch;
+    long long seq;
+  };
+
+  /** The requests for one shard and the thread serving them */
+  struct Queue {
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<Task> tasks;
+    bool stopping = false;
+    std::thread thread;
+  };
+
+  /**
+   * The loop of an executor thread.
+   * \param[in] queue the queue of the executor
+   */
+  void serveQueue(Queue &queue) {
+    while (true) {
+      Task task;
+      {
+        std::unique_lock<std::mutex> guard(queue.lock);
+        queue.ready.wait(
+            guard, [&queue] { return queue.stopping || !queue.tasks.empty(); });
+        if (queue.tasks.empty()) {
+          return;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      replySeq = task.seq;
+      (worker.*task.handler)(task.msg);
+      replySeq = -1;
+      task = Task();
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        idle.notify_all();
+      }
+    }
+  }
+
+  /** The worker whose requests are served */
+  CacheWorker &worker;
+  /** One queue (and thread) per shard */
+  std::vector<Queue> queues;
+  /** The number of requests dispatched but not served yet */
+  std::atomic<size_t> pending{0};
+  /** Guards waiting for pending to drop to zero */
+  std::mutex idleLock;
+  /** Signalled when pending drops to zero */
+  std::condition_variable idle;
+  /** The sequence number of the next request with a reply */
+  long long nextSeq = 0;
+  /** The sequence number of the next reply to be sent */
+  long long sentSeq = 0;
+  /** Guards outbox */
+  std::mutex outboxLock;
+  /** Signalled when a reply is handed over */
+  std::condition_variable replied;
+  /** The replies handed over but not sent yet, by sequence number */
+  std::map<long long, std::pair<MessagePtr, int>> outbox;
+};
+
 void CacheWorker::run() {
-  // Keep processing messages until we get a message with finish tag.
-  for (MessagePtr msg = recv(); msg->tag != Message::FINISH; msg = recv()) {
+  ReceiveRing control(ControlSlots, ControlSlotSize, CONTROL_TAG, true);
+  ReceiveRing blocks(BlockSlots, BlockSlotSize, BLOCK_TAG);
+  if (getShardCount() > 1) {
+    runSharded(control, blocks);
+  } else {
+    // Keep processing messages until we get a message with finish tag.
+    for (MessagePtr msg = nextMessage(control, blocks);
+         msg->tag != Message::FINISH; msg = nextMessage(control, blocks)) {
+      serve(msg);
+      completeReplies(false);
+    }
+  }
+  completeReplies(true);
+}
+
+void CacheWorker::runSharded(ReceiveRing &control, ReceiveRing &blocks) {
+  // The longest time to wait for a reply before checking for requests
+  constexpr std::chrono::microseconds MaxBackoff(64);
+  Executors pool(*this);
+  std::chrono::microseconds backoff(1);
+  while (true) {
+    pool.sendReplies();
+    completeReplies(false);
+    if (!control.ready() && !pool.drained()) {
+      // Replies are owed: wait for them, checking for new requests
+      // less and less often while none arrive
+      pool.awaitReply(backoff);
+      backoff = std::min(backoff * 2, MaxBackoff);
+      continue;
+    }
+    // Otherwise block until the next request arrives
+    backoff = std::chrono::microseconds(1);
+    MessagePtr msg = nextMessage(control, blocks);
     switch (msg->tag) {
     case Message::STORE_BLOCK:
-      storeCacheBlock(msg);
+      pool.dispatch(&CacheWorker::storeCacheBlock, msg, nullptr, false);
       break;
     case Message::GET_BLOCK:
-      sendCacheBlock(msg);
+      pool.dispatch(&CacheWorker::sendCacheBlock, msg, nullptr, true);
+      break;
+    case Message::PROBE_BLOCK:
+      pool.dispatch(&CacheWorker::probeCacheBlock, msg, nullptr, true);
       break;
     case Message::ERASE_BLOCK:
-      eraseCacheBlock(msg);
+      pool.dispatch(&CacheWorker::eraseCacheBlock, msg, nullptr, false);
+      break;
+    case Message::STORE_BLOCKS:
+      for (const MessagePtr &block : Message::unpackBatch(msg)) {
+        pool.dispatch(&CacheWorker::storeCacheBlock, block, msg, false);
+      }
       break;
     default:
-      throw PC2L_EXP("Received unhandled message. Tag=%d", "Need to implement?",
-                     msg->tag);
+      // Requests that involve several blocks (or change a block in
+      // place) are served here, once the earlier ones are done
+      pool.quiesce();
+      pool.sendReplies();
+      if (msg->tag == Message::FINISH) {
+        return;
+      }
+      serve(msg);
+    }
+  }
+}
+
+void CacheWorker::serve(const MessagePtr &msg) {
+  switch (msg->tag) {
+  case Message::STORE_BLOCK:
+    storeCacheBlock(msg);
+    break;
+  case Message::GET_BLOCK:
+    sendCacheBlock(msg);
+    break;
+  case Message::PROBE_BLOCK:
+    probeCacheBlock(msg);
+    break;
+  case Message::ERASE_BLOCK:
+    eraseCacheBlock(msg);
+    break;
+  case Message::DROP_DS:
+    eraseDataStructure(msg);
+    break;
+  case Message::RUN_KERNEL:
+    // kernels may change blocks that are still being sent
+    completeReplies(true);
+    runKernel(msg);
+    break;
+  case Message::UPDATE_ELEMENT:
+    completeReplies(true);
+    updateCacheBlock(msg);
+    break;
+  case Message::GET_BLOCKS:
+    sendCacheBlocks(msg);
+    break;
+  case Message::STORE_BLOCKS:
+    for (const MessagePtr &block : Message::unpackBatch(msg)) {
+      storeCacheBlock(block);
+    }
+    break;
+  default:
+    throw PC2L_EXP("Received unhandled message. Tag=%d", "Need to implement?",
+                   msg->tag);
+  }
+}
+
+MessagePtr CacheWorker::nextMessage(ReceiveRing &control,
+                                    ReceiveRing &blocks) {
+  int sentSize;
+  MessagePtr msg = control.take(sentSize);
+  if (msg->getSize() < sentSize) {
+    // only the header was sent with CONTROL_TAG, see Worker::startSend
+    msg = (sentSize <= BlockSlotSize) ? blocks.take(sentSize)
+                                      : control.takeLarge();
+  }
+  return msg;
+}
+
+void CacheWorker::send(MessagePtr msgPtr, const int destRank) {
+  if (msgPtr && replySeq >= 0) {
+    // an executor's reply is sent by the thread running run
+    executors->postReply(replySeq, std::move(msgPtr), destRank);
+    replySeq = -1;
+  } else if (msgPtr) {
+    replyReqs.push_back(startSend(msgPtr, destRank));
+    replies.push_back(std::move(msgPtr));
+  }
+}
+
+void CacheWorker::completeReplies(bool wait) {
+  if (wait) {
+    MPI_Waitall(replyReqs.size(), replyReqs.data(), MPI_STATUSES_IGNORE);
+    replyReqs.clear();
+    replies.clear();
+    return;
+  }
+  std::vector<int> done(replyReqs.size());
+  int count = 0;
+  MPI_Testsome(replyReqs.size(), replyReqs.data(), &count, done.data(),
+               MPI_STATUSES_IGNORE);
+  if (count == 0 || count == MPI_UNDEFINED) {
+    return;
+  }
+  // completed requests are set to MPI_REQUEST_NULL, so drop them
+  size_t kept = 0;
+  for (size_t i = 0; i < replyReqs.size(); i++) {
+    if (replyReqs[i] != MPI_REQUEST_NULL) {
+      replyReqs[kept] = replyReqs[i];
+      replies[kept++] = std::move(replies[i]);
+    }
+  }
+  replyReqs.resize(kept);
+  replies.resize(kept);
+}
+
+CacheWorker::ReceiveRing::ReceiveRing(int slots, int slotSize, int tag,
+                                      bool postLarge)
+    : slotSize(slotSize), tag(tag), postLarge(postLarge), reqs(slots),
+      buffers(slots), received(slots), indices(slots), statuses(slots) {
+  for (int slot = 0; slot < slots; slot++) {
+    buffers[slot] = MessagePool::acquire(slotSize);
+    post(slot);
+  }
+}
+
+CacheWorker::ReceiveRing::~ReceiveRing() {
+  for (size_t slot = 0; slot < reqs.size(); slot++) {
+    if (received[slot] < 0) {
+      MPI_Cancel(&reqs[slot]);
+      MPI_Wait(&reqs[slot], MPI_STATUS_IGNORE);
     }
+    MessagePool::release(buffers[slot], slotSize);
+  }
+  for (Large &pending : large) {
+    MPI_Cancel(&pending.req);
+    MPI_Wait(&pending.req, MPI_STATUS_IGNORE);
+    MessagePool::release(pending.buffer, pending.size);
+  }
+}
+
+void CacheWorker::ReceiveRing::post(size_t slot) {
+  received[slot] = -1;
+  MPI_Irecv(buffers[slot], slotSize, MPI_CHAR, 0, tag, MPI_COMM_WORLD,
+            &reqs[slot]);
+}
+
+void CacheWorker::ReceiveRing::completed(int count) {
+  for (int i = 0; (count != MPI_UNDEFINED) && (i < count); i++) {
+    MPI_Get_count(&statuses[i], MPI_CHAR, &received[indices[i]]);
+  }
+  if (!postLarge) {
+    return;
+  }
+  // Headers are examined in the order they were sent, which is the
+  // order in which the large messages are sent, so each receive posted
+  // here matches the message of its header
+  for (size_t slot = (head + examined) % reqs.size();
+       examined < reqs.size() && received[slot] >= 0;
+       slot = (slot + 1) % reqs.size(), examined++) {
+    const int size =
+        reinterpret_cast<const Message *>(buffers[slot])->getSize();
+    if (received[slot] < size && size > BlockSlotSize) {
+      Large pending{MPI_REQUEST_NULL, MessagePool::acquire(size), size};
+      MPI_Irecv(pending.buffer, size, MPI_CHAR, 0, LARGE_TAG, MPI_COMM_WORLD,
+                &pending.req);
+      large.push_back(pending);
+    }
+  }
+}
+
+bool CacheWorker::ReceiveRing::ready() {
+  if (received[head] < 0) {
+    int count = 0;
+    MPI_Testsome(reqs.size(), reqs.data(), &count, indices.data(),
+                 statuses.data());
+    completed(count);
   }
+  return received[head] >= 0;
+}
+
+MessagePtr CacheWorker::ReceiveRing::take(int &sentSize) {
+  // Receives may complete out of order (their messages are matched in
+  // order, but may arrive out of order), so the ones that complete
+  // while waiting for the oldest one are noted for later
+  while (received[head] < 0) {
+    int count = 0;
+    MPI_Waitsome(reqs.size(), reqs.data(), &count, indices.data(),
+                 statuses.data());
+    completed(count);
+  }
+  sentSize = reinterpret_cast<const Message *>(buffers[head])->getSize();
+  const int size = received[head];
+  MessagePtr msg;
+  if (size * 2 <= slotSize) {
+    // a small message gets a buffer of its own size, and the buffer of
+    // the slot is posted again
+    char *buffer = MessagePool::acquire(size);
+    std::copy_n(buffers[head], size, buffer);
+    msg = Message::adopt(buffer, size, size);
+  } else {
+    msg = Message::adopt(buffers[head], size, slotSize);
+    buffers[head] = MessagePool::acquire(slotSize);
+  }
+  post(head);
+  head = (head + 1) % reqs.size();
+  if (postLarge) {
+    examined--;
+  }
+  return msg;
+}
+
+MessagePtr CacheWorker::ReceiveRing::takeLarge() {
+  Large next = large.front();
+  large.pop_front();
+  MPI_Wait(&next.req, MPI_STATUS_IGNORE);
+  return Message::adopt(next.buffer, next.size, next.size);
+}
+
+int CacheWorker::getStoredRank(size_t blockTag) {
+  return (blockTag % (System::get().worldSize() - 1)) + 1;
 }
 
 void CacheWorker::storeCacheBlock(const MessagePtr &msgIn) {
   PC2L_DEBUG_START_TIMER()
   MessagePtr msg = msgIn;
   // Clone this message for storing into our cache if it resides in a temporary
-  // buffer
+  // buffer (received messages own theirs, see Worker::recv)
   if (!msg->ownBuf) {
     msg = Message::create(*msg);
   }
@@ -85,8 +522,12 @@ void CacheWorker::storeCacheBlock(const MessagePtr &msgIn) {
   // correct (it could change)
   if (existingEntry->tag != Message::BLOCK_NOT_FOUND) {
     currentBytes -= existingEntry->getSize();
+    if (existingEntry != msg) {
+      existingEntry->cached = false;
+    }
   }
   currentBytes += msg->getSize();
+  msg->cached = true;
   // Put a clone of the message in the cache
   //        cache[msg->key] = msg;
   addToCache(msg);
@@ -99,6 +540,7 @@ void CacheWorker::eraseCacheBlock(const MessagePtr &msg) {
       entry->tag != Message::BLOCK_NOT_FOUND) {
     PC2L_PROFILE(cacheHits++;)
     // Decrement current bytes that worker is holding
+    entry->cached = false;
     eraseFromCache(entry->key);
     currentBytes -= entry->getSize();
     //            cache.erase(entry);
@@ -113,6 +555,39 @@ void CacheWorker::eraseCacheBlock(const MessagePtr &msg) {
   // }
 }
 
+void CacheWorker::evictCacheBlock(const MessagePtr &evicted) {
+  // Hold on to the block since erasing it may release the last reference
+  const MessagePtr block = evicted;
+  eraseCacheBlock(block);
+  if (block->dirty) {
+    writeBackBlock(block);
+  }
+}
+
+void CacheWorker::writeBackBlock(const MessagePtr &block) {
+  send(block, getStoredRank(block->blockTag));
+}
+
+void CacheWorker::eraseDataStructure(const MessagePtr &msg) {
+  currentBytes -= eraseDsFromCache(msg->dsTag);
+}
+
+void CacheWorker::runKernel(const MessagePtr &msg) {
+  size_t id;
+  std::memcpy(&id, msg->getPayload(), sizeof(id));
+  const Kernel kernel = KernelRegistry::find(id);
+  if (kernel == nullptr) {
+    throw PC2L_EXP("Received unknown kernel. Id=%zu",
+                   "Kernels must be registered on every process", id);
+  }
+  kernel(*this, msg);
+}
+
+MessagePtr CacheWorker::findCacheBlock(size_t dsTag, size_t blockTag) {
+  const auto &entry = getFromCache(Message::getKey(dsTag, blockTag));
+  return (entry->tag != Message::BLOCK_NOT_FOUND) ? entry : nullptr;
+}
+
 void CacheWorker::sendCacheBlock(const MessagePtr &msg) {
   PC2L_DEBUG_START_TIMER()
   // Get entry for key, if present in the cache
@@ -122,17 +597,83 @@ void CacheWorker::sendCacheBlock(const MessagePtr &msg) {
     PC2L_PROFILE(cacheHits++;)
     refer(entry);
     send(entry, msg->srcRank);
+  } else {
+    // When control drops here, that means the requested block was
+    // not found in cache.  In this situation, we send a
+    // block-not-found message back.
+    send(Message::create(0, Message::BLOCK_NOT_FOUND, 0, msg->dsTag,
+                         msg->blockTag),
+         msg->srcRank);
   }
   PC2L_PROFILE(accesses++;)
-  //     // When control drops here, that means the requested block was
-  //     // not found in cache.  In this situation, we send a
-  //     // block-not-found message back.
-  //     blockNotFoundMsg->dsTag    = msg->dsTag;
-  //     blockNotFoundMsg->blockTag = msg->blockTag;
-  //     send(blockNotFoundMsg, msg->srcRank);
-  // }
   PC2L_DEBUG_STOP_TIMER("sendCacheBlock() on node " << MPI_GET_RANK() << " ")
 }
+
+void CacheWorker::updateCacheBlock(const MessagePtr &msg) {
+  const auto &entry = getFromCache(msg->key);
+  if (entry->tag == Message::BLOCK_NOT_FOUND) {
+    send(Message::create(0, Message::BLOCK_NOT_FOUND, 0, msg->dsTag,
+                         msg->blockTag),
+         msg->srcRank);
+    return;
+  }
+  refer(entry);
+  UpdateHeader header;
+  std::memcpy(&header, msg->getPayload(), sizeof(header));
+  MessagePtr reply = Message::create(header.size, Message::UPDATE_ELEMENT, 0,
+                                     msg->dsTag, msg->blockTag);
+  applyUpdate(entry, msg->getPayload(), reply->getPayload());
+  send(reply, msg->srcRank);
+}
+
+void CacheWorker::applyUpdate(const MessagePtr &block, const char *update,
+                              char *old) {
+  UpdateHeader header;
+  std::memcpy(&header, update, sizeof(header));
+  const Update apply = UpdateRegistry::find(header.id);
+  if (apply == nullptr) {
+    throw PC2L_EXP("Received unknown update. Id=%zu",
+                   "Updates must be registered on every process", header.id);
+  }
+  char *value = block->getPayload() + header.offset;
+  std::memcpy(old, value, header.size);
+  apply(value, update + sizeof(header));
+}
+
+void CacheWorker::sendCacheBlocks(const MessagePtr &msg) {
+  const size_t count = msg->getPayloadSize() / sizeof(size_t);
+  std::vector<MessagePtr> blocks;
+  blocks.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    size_t key;
+    std::memcpy(&key, msg->getPayload() + i * sizeof(size_t), sizeof(key));
+    if (const auto &entry = getFromCache(key);
+        entry->tag != Message::BLOCK_NOT_FOUND) {
+      PC2L_PROFILE(cacheHits++;)
+      refer(entry);
+      blocks.push_back(entry);
+    } else {
+      blocks.push_back(Message::create(0, Message::BLOCK_NOT_FOUND, 0,
+                                       key >> 32, key & 0xFFFFFFFFU));
+    }
+    PC2L_PROFILE(accesses++;)
+  }
+  for (const auto &batch : Message::splitBatches(blocks)) {
+    send((batch.size() == 1)
+             ? batch.front()
+             : Message::createBatch(Message::STORE_BLOCKS, batch),
+         msg->srcRank);
+  }
+}
+
+void CacheWorker::probeCacheBlock(const MessagePtr &msg) {
+  const bool found =
+      getFromCache(msg->key)->tag != Message::BLOCK_NOT_FOUND;
+  send(Message::create(0, found ? Message::PROBE_BLOCK
+                                : Message::BLOCK_NOT_FOUND,
+                       0, msg->dsTag, msg->blockTag),
+       msg->srcRank);
+}
 END_NAMESPACE(pc2l);
 // }   // end namespace pc2l
 
@@ -0,0 +1,101 @@
+#ifndef KERNEL_CPP
+#define KERNEL_CPP
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+
+#include "Kernel.h"
+#include "Exception.h"
+#include <functional>
+#include <unordered_map>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+/**
+ * The map of registered kernels. This is a function-local static so
+ * that it is constructed before the first kernel is registered,
+ * regardless of the order in which static objects are initialized.
+ */
+static std::unordered_map<size_t, Kernel> &kernels() {
+  static std::unordered_map<size_t, Kernel> registry;
+  return registry;
+}
+
+size_t KernelRegistry::add(const std::string &name, Kernel kernel) {
+  const size_t id = std::hash<std::string>{}(name);
+  // a different kernel under the same id would be run in its place
+  if (const auto [entry, added] = kernels().emplace(id, kernel);
+      !added && entry->second != kernel) {
+    throw PC2L_EXP("Kernel %s has the same id (%zu) as another kernel",
+                   "Rename one of the kernel types", name.c_str(), id);
+  }
+  return id;
+}
+
+Kernel KernelRegistry::find(size_t id) {
+  const auto entry = kernels().find(id);
+  return (entry != kernels().end()) ? entry->second : nullptr;
+}
+
+/**
+ * The map of registered updates, which is a function-local static for
+ * the same reason as the map of kernels.
+ */
+static std::unordered_map<size_t, Update> &updates() {
+  static std::unordered_map<size_t, Update> registry;
+  return registry;
+}
+
+size_t UpdateRegistry::add(const std::string &name, Update update) {
+  const size_t id = std::hash<std::string>{}(name);
+  if (const auto [entry, added] = updates().emplace(id, update);
+      !added && entry->second != update) {
+    throw PC2L_EXP("Update %s has the same id (%zu) as another update",
+                   "Rename one of the update types", name.c_str(), id);
+  }
+  return id;
+}
+
+Update UpdateRegistry::find(size_t id) {
+  const auto entry = updates().find(id);
+  return (entry != updates().end()) ? entry->second : nullptr;
+}
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
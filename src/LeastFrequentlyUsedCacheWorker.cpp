@@ -38,7 +38,9 @@
 //---------------------------------------------------------------------
 
 #include "LeastFrequentlyUsedCacheWorker.h"
+#include <algorithm>
 #include "Exception.h"
+#include "System.h"
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
@@ -58,6 +60,39 @@ void LeastFrequentlyUsedCacheWorker::eraseFromCache(size_t key) {
   placeInQueue.erase(key);
 }
 
+size_t LeastFrequentlyUsedCacheWorker::eraseDsFromCache(size_t dsTag) {
+  size_t bytes = 0;
+  for (auto entry = placeInQueue.begin(); entry != placeInQueue.end();) {
+    if (auto item = entry->second; item->msg->dsTag == dsTag) {
+      bytes += item->msg->getSize();
+      item->msg->cached = false;
+      // unlike eviction, nothing has unlinked the item from its frequency
+      // queue yet, so do it here
+      const auto frequency = item->frequency;
+      auto &itemQueue = queues[frequency];
+      itemQueue.erase(item);
+      if (itemQueue.empty()) {
+        queues.erase(frequency);
+      }
+      entry = placeInQueue.erase(entry);
+    } else {
+      entry++;
+    }
+  }
+  return bytes;
+}
+
+std::vector<MessagePtr>
+LeastFrequentlyUsedCacheWorker::getDsFromCache(size_t dsTag) {
+  std::vector<MessagePtr> blocks;
+  for (const auto &entry : placeInQueue) {
+    if (entry.second->msg->dsTag == dsTag) {
+      blocks.push_back(entry.second->msg);
+    }
+  }
+  return blocks;
+}
+
 MessagePtr &LeastFrequentlyUsedCacheWorker::getFromCache(size_t key) {
   if (placeInQueue.find(key) != placeInQueue.end()) {
     return placeInQueue[key]->msg;
@@ -67,29 +102,42 @@ MessagePtr &LeastFrequentlyUsedCacheWorker::getFromCache(size_t key) {
 }
 
 void LeastFrequentlyUsedCacheWorker::refer(const MessagePtr &msg) {
-  if (MPI_GET_RANK() != 0)
+  if (System::get().worldRank() != 0)
     return;
   const auto key = msg->key;
   if (auto msgPlace = placeInQueue.find(key); msgPlace == placeInQueue.end()) {
     // Use eviction strategy if cache is at capacity
     if (currentBytes + msg->getSize() > cacheSize) {
-      // Get the queue for the smallest frequency (always at the beginning
-      // of the map of queues)
-      auto &smallestFreqQueue = queues.begin()->second;
-      // Item at the end of this queue is the LRU
-      auto evictedItem = smallestFreqQueue.back();
-      smallestFreqQueue.pop_back();
-      // if this frequency queue is now empty, erase the frequency from the
-      // map of all freq. queues
-      if (smallestFreqQueue.empty()) {
-        queues.erase(evictedItem.frequency);
+      // Walk the queues from the smallest frequency (always at the
+      // beginning of the map of queues) and, within a queue, from the LRU
+      // item at its end, until we find a block that is not pinned
+      bool evictedAny = false;
+      for (auto freq = queues.begin(); freq != queues.end(); freq++) {
+        auto &freqQueue = freq->second;
+        auto victim = std::find_if(
+            freqQueue.rbegin(), freqQueue.rend(),
+            [](const CacheItem &item) { return item.msg->pins == 0; });
+        if (victim == freqQueue.rend()) {
+          continue;
+        }
+        MessagePtr evicted = victim->msg;
+        freqQueue.erase(std::next(victim).base());
+        // if this frequency queue is now empty, erase the frequency from the
+        // map of all freq. queues
+        if (freqQueue.empty()) {
+          queues.erase(freq);
+        }
+        // send evicted block to remote cacheworker (if it was written)
+        evictCacheBlock(evicted);
+        evictedAny = true;
+        break;
+      }
+      if (!evictedAny && !placeInQueue.empty()) {
+        throw PC2L_EXP("Cannot make room for block %u of data structure %u: "
+                       "every cached block is pinned",
+                       "Release a lease before fetching more blocks",
+                       msg->blockTag, msg->dsTag);
       }
-      // send evicted block to remote cacheworker
-      MessagePtr evicted = evictedItem.msg;
-      eraseCacheBlock(evicted);
-      const int destRank =
-          (evicted->blockTag % (System::get().worldSize() - 1)) + 1;
-      send(evicted, destRank);
     }
   } else {
     // If the block is present in the cache, we need to update which
@@ -38,7 +38,9 @@
 //---------------------------------------------------------------------
 
 #include "LeastRecentlyUsedCacheWorker.h"
+#include <iterator>
 #include "Exception.h"
+#include "System.h"
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
@@ -59,27 +61,65 @@ void LeastRecentlyUsedCacheWorker::eraseFromCache(size_t key) {
   cache.erase(key);
 }
 
+size_t LeastRecentlyUsedCacheWorker::eraseDsFromCache(size_t dsTag) {
+  size_t bytes = 0;
+  for (auto entry = cache.begin(); entry != cache.end();) {
+    if (entry->second.msg->dsTag == dsTag) {
+      bytes += entry->second.msg->getSize();
+      entry->second.msg->cached = false;
+      entry = cache.erase(entry);
+    } else {
+      entry++;
+    }
+  }
+  // The queue is only maintained on the manager, so filter it by key
+  // rather than trusting the iterators stored with each item
+  queue.remove_if([dsTag](size_t key) { return (key >> 32) == dsTag; });
+  return bytes;
+}
+
+std::vector<MessagePtr>
+LeastRecentlyUsedCacheWorker::getDsFromCache(size_t dsTag) {
+  std::vector<MessagePtr> blocks;
+  for (const auto &entry : cache) {
+    if (entry.second.msg->dsTag == dsTag) {
+      blocks.push_back(entry.second.msg);
+    }
+  }
+  return blocks;
+}
+
 void LeastRecentlyUsedCacheWorker::refer(const MessagePtr &msg) {
-  if (MPI_GET_RANK() != 0)
+  if (System::get().worldRank() != 0)
     return;
   const auto key = msg->key;
   if (auto entry = cache.find(key); entry == cache.end()) {
     // Use eviction strategy if cache is overfull
     if (currentBytes + msg->getSize() > cacheSize) {
-      auto last = queue.back();
-      queue.pop_back();
-      // send evicted block to remote cacheworker
-      // this copies right now (do I want this?)
-      MessagePtr evicted = cache[last].msg;
-      eraseCacheBlock(evicted);
-      const int destRank =
-          (evicted->blockTag % (System::get().worldSize() - 1)) + 1;
-      send(evicted, destRank);
+      // Evict the least recently used block that is not pinned
+      auto last = queue.rbegin();
+      while (last != queue.rend() && cache[*last].msg->pins != 0) {
+        last++;
+      }
+      if (last != queue.rend()) {
+        MessagePtr evicted = cache[*last].msg;
+        queue.erase(std::next(last).base());
+        // send evicted block to remote cacheworker (if it was written)
+        evictCacheBlock(evicted);
+      } else if (!queue.empty()) {
+        throw PC2L_EXP("Cannot make room for block %u of data structure %u: "
+                       "every cached block is pinned",
+                       "Release a lease before fetching more blocks",
+                       msg->blockTag, msg->dsTag);
+      }
     }
   } else if (queue.size() > 0) {
     // If the block is present in the cache, we need to update its place in
     // the queue
     queue.erase(entry->second.placeInQueue);
+    queue.push_front(key);
+    entry->second.placeInQueue = queue.begin();
+    return;
   }
   // Update the reference in the order queue
   queue.push_front(key);
@@ -40,7 +40,10 @@
 // make a workhorse
 
 #include "Message.h"
+#include "Exception.h"
+#include "MessagePool.h"
 #include <algorithm>
+#include <limits>
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
@@ -64,12 +67,13 @@ size_t Message::getKey(unsigned int dsTag, unsigned int blockTag) noexcept {
 // Create a message from scratch using dynamic memory
 MessagePtr Message::create(const int dataSize, const MsgTag tag,
                            const int srcRank, size_t dsTag, size_t blockTag) {
-  // First create a dynamic memory block for this message, even
+  // First obtain a (recycled) memory block for this message, even
   // though we are going to return it as if it were an object.
-  char *rawBuf = new char[dataSize + sizeof(Message)];
+  char *rawBuf = MessagePool::acquire(dataSize + sizeof(Message));
   // Now use placement new to initialize the message
   Message *msg = new (rawBuf) Message(tag, srcRank, dataSize + sizeof(Message),
                                       true, rawBuf + sizeof(Message));
+  msg->capacity = msg->size;
   msg->dsTag = dsTag;
   msg->blockTag = blockTag;
   msg->key = getKey(dsTag, blockTag);
@@ -94,12 +98,100 @@ MessagePtr Message::create(const Message &src) {
   msg->blockTag = src.blockTag;
   msg->dsTag = src.dsTag;
   msg->key = src.key;
+  msg->dirty = src.dirty;
   // Copy the data from source to the newly created message
   std::copy_n(src.getPayload(), src.getPayloadSize(), msg->getPayload());
   // Return the newly created msg
   return msg;
 }
 
+void Message::MessageDeleter::release(Message *msg) noexcept {
+  const size_t size = msg->capacity;
+  msg->~Message();
+  MessagePool::release(reinterpret_cast<char *>(msg), size);
+}
+
+MessagePtr Message::createReceived(const int size,
+                                  const std::function<void(char *)> &receive) {
+  char *rawBuf = MessagePool::acquire(size);
+  try {
+    receive(rawBuf);
+  } catch (...) {
+    MessagePool::release(rawBuf, size);
+    throw;
+  }
+  return adopt(rawBuf, size, size);
+}
+
+MessagePtr Message::adopt(char *buffer, const int size, const int capacity) {
+  // The header is the sender's, so it is only reinterpreted here
+  Message *msg = reinterpret_cast<Message *>(buffer);
+  msg->size = size;
+  msg->capacity = capacity;
+  msg->ownBuf = true;
+  msg->payload = buffer + sizeof(Message);
+  msg->cached = false;
+  msg->pins = 0;
+  return MessagePtr(msg, MessageDeleter());
+}
+
+/**
+ * Round the size of a message in a batch up so that the next message
+ * starts aligned.
+ */
+static size_t batchedSize(const Message &msg) {
+  const size_t align = alignof(Message);
+  return (msg.getSize() + align - 1) / align * align;
+}
+
+MessagePtr Message::createBatch(const MsgTag tag,
+                                const std::vector<MessagePtr> &msgs) {
+  size_t size = 0;
+  for (const auto &msg : msgs) {
+    size += batchedSize(*msg);
+  }
+  if (size > std::numeric_limits<int>::max() - sizeof(Message)) {
+    throw PC2L_EXP("Cannot batch %zu messages of %zu bytes in total",
+                   "Split the messages with splitBatches", msgs.size(),
+                   size);
+  }
+  MessagePtr batch = Message::create(size, tag);
+  char *dest = batch->getPayload();
+  for (const auto &msg : msgs) {
+    // the header and the payload of a message are contiguous
+    std::copy_n(reinterpret_cast<const char *>(msg.get()), msg->getSize(),
+                dest);
+    dest += batchedSize(*msg);
+  }
+  return batch;
+}
+
+std::vector<std::vector<MessagePtr>>
+Message::splitBatches(const std::vector<MessagePtr> &msgs) {
+  std::vector<std::vector<MessagePtr>> batches;
+  size_t bytes = 0;
+  for (const auto &msg : msgs) {
+    const size_t size = batchedSize(*msg);
+    if (batches.empty() || bytes + size > MaxBatchSize) {
+      batches.emplace_back();
+      bytes = 0;
+    }
+    batches.back().push_back(msg);
+    bytes += size;
+  }
+  return batches;
+}
+
+std::vector<MessagePtr> Message::unpackBatch(const MessagePtr &batch) {
+  std::vector<MessagePtr> msgs;
+  char *const end = batch->getPayload() + batch->getPayloadSize();
+  for (char *next = batch->getPayload(); next < end;) {
+    msgs.push_back(Message::create(next));
+    next += batchedSize(*msgs.back());
+  }
+  return msgs;
+}
+
 END_NAMESPACE(pc2l);
 // }   // end namespace pc2l
 
@@ -0,0 +1,219 @@
+#ifndef MESSAGE_POOL_CPP
+#define MESSAGE_POOL_CPP
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+
+#include "MessagePool.h"
+#include <algorithm>
+#include <new>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+// The pools live as long as their thread (or the program), but messages
+// held by static objects may be released after they are destroyed. The
+// plain flags below stay usable then and tell release to free buffers
+// instead.
+static thread_local bool poolDestroyed = false;
+static bool sharedDestroyed = false;
+
+MessagePool::Pool::~Pool() {
+  poolDestroyed = true;
+  // the buffers of an exiting thread are still useful to the others
+  for (auto &[size, buffers] : freeLists) {
+    for (char *buffer : buffers) {
+      share(buffer, size);
+    }
+  }
+}
+
+MessagePool::Shared::~Shared() {
+  sharedDestroyed = true;
+  for (auto &[size, buffers] : freeLists) {
+    for (char *buffer : buffers) {
+      MessagePool::free(buffer, size);
+    }
+  }
+}
+
+MessagePool::Pool *MessagePool::local() noexcept {
+  static thread_local Pool pool;
+  return poolDestroyed ? nullptr : &pool;
+}
+
+MessagePool::Shared *MessagePool::shared() noexcept {
+  static Shared pool;
+  return sharedDestroyed ? nullptr : &pool;
+}
+
+char *MessagePool::acquire(size_t size) {
+  const size_t bytes = classSize(size);
+  if (Pool *pool = local(); pool != nullptr) {
+    auto &buffers = pool->freeLists[bytes];
+    if (buffers.empty()) {
+      refill(buffers, bytes);
+      pool->stats.retainedBuffers += buffers.size();
+      pool->stats.retainedBytes += buffers.size() * bytes;
+    }
+    if (!buffers.empty()) {
+      char *buffer = buffers.back();
+      buffers.pop_back();
+      pool->stats.reused++;
+      pool->stats.retainedBuffers--;
+      pool->stats.retainedBytes -= bytes;
+      return buffer;
+    }
+    pool->stats.allocated++;
+  }
+  const size_t align = (bytes < PageSize) ? CacheLine : PageSize;
+  return static_cast<char *>(::operator new(bytes, std::align_val_t(align)));
+}
+
+void MessagePool::release(char *buffer, size_t size) noexcept {
+  const size_t bytes = classSize(size);
+  Pool *pool = local();
+  if (pool == nullptr) {
+    share(buffer, bytes);
+    return;
+  }
+  try {
+    if (auto &buffers = pool->freeLists[bytes];
+        buffers.size() < LocalBuffers) {
+      buffers.push_back(buffer);
+      pool->stats.released++;
+      pool->stats.retainedBuffers++;
+      pool->stats.retainedBytes += bytes;
+      return;
+    }
+  } catch (const std::bad_alloc &) {
+    // fall back to the shared pool
+  }
+  if (share(buffer, bytes)) {
+    pool->stats.released++;
+  }
+}
+
+void MessagePool::refill(std::vector<char *> &buffers, size_t size) noexcept {
+  Shared *pool = shared();
+  if (pool == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  auto found = pool->freeLists.find(size);
+  if (found == pool->freeLists.end()) {
+    return;
+  }
+  auto &source = found->second;
+  const size_t count = std::min(source.size(), LocalBuffers / 2);
+  try {
+    buffers.insert(buffers.end(), source.end() - count, source.end());
+  } catch (const std::bad_alloc &) {
+    return;
+  }
+  source.resize(source.size() - count);
+  pool->retainedBuffers -= count;
+  pool->retainedBytes -= count * size;
+}
+
+bool MessagePool::share(char *buffer, size_t size) noexcept {
+  if (Shared *pool = shared(); pool != nullptr) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (pool->retainedBytes + size <= pool->retainLimit) {
+      try {
+        pool->freeLists[size].push_back(buffer);
+        pool->retainedBuffers++;
+        pool->retainedBytes += size;
+        return true;
+      } catch (const std::bad_alloc &) {
+        // free the buffer instead
+      }
+    }
+  }
+  free(buffer, size);
+  return false;
+}
+
+MessagePool::Stats MessagePool::getStats() noexcept {
+  const Pool *pool = local();
+  Stats stats = (pool != nullptr) ? pool->stats : Stats();
+  if (Shared *common = shared(); common != nullptr) {
+    std::lock_guard<std::mutex> lock(common->mutex);
+    stats.retainedBuffers += common->retainedBuffers;
+    stats.retainedBytes += common->retainedBytes;
+  }
+  return stats;
+}
+
+void MessagePool::setRetainLimit(size_t bytes) noexcept {
+  if (Shared *pool = shared(); pool != nullptr) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->retainLimit = bytes;
+  }
+}
+
+void MessagePool::trim() noexcept {
+  if (Pool *pool = local(); pool != nullptr) {
+    for (auto &[size, buffers] : pool->freeLists) {
+      for (char *buffer : buffers) {
+        free(buffer, size);
+      }
+      buffers.clear();
+    }
+    pool->stats.retainedBuffers = 0;
+    pool->stats.retainedBytes = 0;
+  }
+  if (Shared *pool = shared(); pool != nullptr) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    for (auto &[size, buffers] : pool->freeLists) {
+      for (char *buffer : buffers) {
+        free(buffer, size);
+      }
+      buffers.clear();
+    }
+    pool->retainedBuffers = 0;
+    pool->retainedBytes = 0;
+  }
+}
+
+void MessagePool::free(char *buffer, size_t size) noexcept {
+  const size_t align = (size < PageSize) ? CacheLine : PageSize;
+  ::operator delete(buffer, std::align_val_t(align));
+}
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
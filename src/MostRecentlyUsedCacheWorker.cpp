@@ -39,30 +39,41 @@
 
 #include "MostRecentlyUsedCacheWorker.h"
 #include "Exception.h"
+#include "System.h"
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
 void MostRecentlyUsedCacheWorker::refer(const MessagePtr &msg) {
-  if (MPI_GET_RANK() != 0)
+  if (System::get().worldRank() != 0)
     return;
   const auto key = msg->key;
   if (auto entry = cache.find(key); entry == cache.end()) {
     // Use eviction strategy if cache is overfull
     if (currentBytes + msg->getSize() > cacheSize) {
-      // Get the most recently used and erase it
-      auto first = queue.front();
-      queue.pop_front();
-      // send evicted block to remote cacheworker
-      MessagePtr evicted = getFromCache(first);
-      eraseCacheBlock(evicted);
-      const int destRank =
-          (evicted->blockTag % (System::get().worldSize() - 1)) + 1;
-      send(evicted, destRank);
+      // Get the most recently used block that is not pinned and erase it
+      auto first = queue.begin();
+      while (first != queue.end() && getFromCache(*first)->pins != 0) {
+        first++;
+      }
+      if (first != queue.end()) {
+        MessagePtr evicted = getFromCache(*first);
+        queue.erase(first);
+        // send evicted block to remote cacheworker (if it was written)
+        evictCacheBlock(evicted);
+      } else if (!queue.empty()) {
+        throw PC2L_EXP("Cannot make room for block %u of data structure %u: "
+                       "every cached block is pinned",
+                       "Release a lease before fetching more blocks",
+                       msg->blockTag, msg->dsTag);
+      }
     }
   } else {
     // If the block is present in the cache, we need to update its place in
     // the queue
     queue.erase(entry->second.placeInQueue);
+    queue.push_front(key);
+    entry->second.placeInQueue = queue.begin();
+    return;
   }
   // new block goes to the beginning (it is mru)
   queue.push_front(key);
@@ -0,0 +1,124 @@
+#ifndef PREFETCHER_CPP
+#define PREFETCHER_CPP
+
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie               rudiejd@miamioh.edu
+
+#include "Prefetcher.h"
+#include <algorithm>
+#include <cstdlib>
+
+// namespace pc2l {
+BEGIN_NAMESPACE(pc2l);
+
+Prefetcher::Prefetcher(PrefetchStrategy strategy,
+                       size_t blockElementCount) noexcept
+    : adaptive(strategy == ADAPTIVE), blockElementCount(blockElementCount),
+      stride((strategy == BACKWARD_SEQUENTIAL) ? -1 : 1),
+      confidence((strategy == FORWARD_SEQUENTIAL ||
+                  strategy == BACKWARD_SEQUENTIAL)
+                     ? 2
+                     : 0) {}
+
+const std::vector<size_t> &Prefetcher::observe(size_t index,
+                                               size_t blockCount,
+                                               unsigned int depth) {
+  toFetch.clear();
+  if (adaptive && lastBlock != -1UL && index != lastIndex) {
+    const long long delta = static_cast<long long>(index - lastIndex);
+    if (delta == stride) {
+      confidence = std::min(confidence + 1, 2u);
+    } else {
+      stride = delta;
+      confidence = 0;
+    }
+  }
+  lastIndex = index;
+  const size_t blockTag = index / blockElementCount;
+  if (blockTag == lastBlock) {
+    return toFetch;
+  }
+  lastBlock = blockTag;
+  if (auto hit = std::find(predicted.begin(), predicted.end(), blockTag);
+      hit != predicted.end()) {
+    useful++;
+    predicted.erase(hit);
+  } else {
+    missed++;
+  }
+  if (confidence == 0) {
+    return toFetch;
+  }
+  // Strides shorter than a block go through every block on the way, so
+  // predict the neighbouring blocks; longer strides skip blocks, so
+  // predict the blocks of the values they land on
+  const long long elements = static_cast<long long>(blockElementCount);
+  const long long step = (std::abs(stride) < elements)
+                             ? ((stride < 0) ? -elements : elements)
+                             : stride;
+  long long next = static_cast<long long>(index);
+  for (unsigned int k = 0; k < depth; k++) {
+    next += step;
+    if (next < 0 || next / elements >= static_cast<long long>(blockCount)) {
+      break;
+    }
+    const size_t tag = next / elements;
+    if (std::find(predicted.begin(), predicted.end(), tag) ==
+        predicted.end()) {
+      predicted.push_back(tag);
+      toFetch.push_back(tag);
+      issued++;
+    }
+  }
+  // Forget predictions that are too old to be accessed any more
+  while (predicted.size() > 2 * static_cast<size_t>(depth)) {
+    predicted.pop_front();
+  }
+  return toFetch;
+}
+
+double Prefetcher::getAccuracy() const noexcept {
+  return (issued > 0) ? static_cast<double>(useful) / issued : 0;
+}
+
+double Prefetcher::getCoverage() const noexcept {
+  const size_t accesses = useful + missed;
+  return (accesses > 0) ? static_cast<double>(useful) / accesses : 0;
+}
+
+END_NAMESPACE(pc2l);
+// }   // end namespace pc2l
+
+#endif
@@ -39,11 +39,39 @@
 
 #include "PseudoLRUCacheWorker.h"
 #include "Exception.h"
+#include "System.h"
 
 // namespace pc2l {
 BEGIN_NAMESPACE(pc2l);
 void PseudoLRUCacheWorker::eraseFromCache(size_t key) { cache.erase(key); }
 
+size_t PseudoLRUCacheWorker::eraseDsFromCache(size_t dsTag) {
+  size_t bytes = 0;
+  for (auto entry = cache.begin(); entry != cache.end();) {
+    if (entry->second.msg->dsTag == dsTag) {
+      bytes += entry->second.msg->getSize();
+      entry->second.msg->cached = false;
+      if (entry->second.wasUsed && trueCount > 0) {
+        trueCount--;
+      }
+      entry = cache.erase(entry);
+    } else {
+      entry++;
+    }
+  }
+  return bytes;
+}
+
+std::vector<MessagePtr> PseudoLRUCacheWorker::getDsFromCache(size_t dsTag) {
+  std::vector<MessagePtr> blocks;
+  for (const auto &entry : cache) {
+    if (entry.second.msg->dsTag == dsTag) {
+      blocks.push_back(entry.second.msg);
+    }
+  }
+  return blocks;
+}
+
 void PseudoLRUCacheWorker::addToCache(pc2l::MessagePtr &msg) {
   cache[msg->key] = {msg};
 }
@@ -57,7 +85,7 @@ MessagePtr &PseudoLRUCacheWorker::getFromCache(size_t key) {
 }
 
 void PseudoLRUCacheWorker::refer(const MessagePtr &msg) {
-  if (MPI_GET_RANK() != 0)
+  if (System::get().worldRank() != 0)
     return;
   const auto key = msg->key;
   if (auto entry = cache.find(key); entry == cache.end()) {
@@ -65,18 +93,25 @@ void PseudoLRUCacheWorker::refer(const MessagePtr &msg) {
     if (currentBytes + msg->getSize() > cacheSize) {
       // the cache is full now and we can start resetting the mru bits
       full = true;
-      // the first cache item without MRU bit set is removed
+      // the first unpinned cache item without MRU bit set is removed,
+      // or any unpinned one if every item has its MRU bit set
       MessagePtr evicted;
-      for (auto e : cache) {
-        if (!e.second.wasUsed) {
+      for (const auto &e : cache) {
+        if (e.second.msg->pins == 0 && (!evicted || !e.second.wasUsed)) {
           evicted = e.second.msg;
-          break;
+          if (!e.second.wasUsed) {
+            break;
+          }
         }
       }
-      eraseCacheBlock(evicted);
-      const int destRank =
-          (evicted->blockTag % (System::get().worldSize() - 1)) + 1;
-      send(evicted, destRank);
+      if (evicted) {
+        evictCacheBlock(evicted);
+      } else if (!cache.empty()) {
+        throw PC2L_EXP("Cannot make room for block %u of data structure %u: "
+                       "every cached block is pinned",
+                       "Release a lease before fetching more blocks",
+                       msg->blockTag, msg->dsTag);
+      }
     }
   } else {
     // If the block is present in the cache, we need to update its MRU bit
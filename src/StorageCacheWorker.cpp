@@ -44,18 +44,55 @@
 BEGIN_NAMESPACE(pc2l);
 
 void StorageCacheWorker::addToCache(pc2l::MessagePtr &msg) {
-  cache[msg->key] = msg;
+  shards[getShard(msg->key)][msg->key] = msg;
 }
 
 MessagePtr &StorageCacheWorker::getFromCache(size_t key) {
-  if (cache.find(key) != cache.end()) {
-    return cache[key];
+  auto &cache = shards[getShard(key)];
+  if (auto entry = cache.find(key); entry != cache.end()) {
+    return entry->second;
   } else {
     return blockNotFoundMsg;
   }
 }
 
-void StorageCacheWorker::eraseFromCache(size_t key) { cache.erase(key); }
+void StorageCacheWorker::eraseFromCache(size_t key) {
+  shards[getShard(key)].erase(key);
+}
+
+size_t StorageCacheWorker::eraseDsFromCache(size_t dsTag) {
+  size_t bytes = 0;
+  for (auto &cache : shards) {
+    for (auto entry = cache.begin(); entry != cache.end();) {
+      if (entry->second->dsTag == dsTag) {
+        bytes += entry->second->getSize();
+        entry->second->cached = false;
+        entry = cache.erase(entry);
+      } else {
+        entry++;
+      }
+    }
+  }
+  return bytes;
+}
+
+std::vector<MessagePtr> StorageCacheWorker::getDsFromCache(size_t dsTag) {
+  std::vector<MessagePtr> blocks;
+  for (const auto &cache : shards) {
+    for (const auto &entry : cache) {
+      if (entry.second->dsTag == dsTag) {
+        blocks.push_back(entry.second);
+      }
+    }
+  }
+  return blocks;
+}
+
+size_t StorageCacheWorker::getShard(size_t key) const noexcept {
+  // A worker holds every (worldSize - 1)-th block, so the key is mixed
+  // before it is reduced, lest all its blocks end up in a few shards
+  return ((key * 0x9E3779B97F4A7C15ULL) >> 32) % shards.size();
+}
 
 void StorageCacheWorker::refer(const MessagePtr &msg) {}
 END_NAMESPACE(pc2l);
@@ -65,9 +65,13 @@ CacheManager &System::cacheManager() { return *manager; }
 void System::initialize(int &argc, char *argv[], bool initMPI) {
   // Check an iniitalize MPI
   if (initMPI) {
-    MPI_INIT(argc, argv);
+    // Workers may run several threads, but only one of them uses MPI.
+    // The manager's progress thread takes turns with the application.
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
   }
   size = MPI_GET_SIZE();
+  rank = MPI_GET_RANK();
   assert(size > 0);
 }
 
@@ -88,6 +92,8 @@ void System::start(const EvictionStrategy es, const OpMode mode) {
     break;
   }
   manager->cacheSize = cacheSize;
+  manager->writeBackLimit = writeBackLimit;
+  manager->useProgressThread = progressThread;
   // Next, based on our operation mode, perform different initialization.
   switch (mode) {
   case OneWriter_DistributedCache:
@@ -102,10 +108,12 @@ void System::start(const EvictionStrategy es, const OpMode mode) {
 
 int System::worldSize() noexcept { return size; }
 
+int System::worldRank() noexcept { return rank; }
+
 void System::stop() {
   // If this is the manager process, then send finish messages to
   // all the workers to let them them know they need to stop running.
-  if (MPI_GET_RANK() == 0) {
+  if (rank == 0) {
     manager->finalize();
   }
 }
@@ -117,14 +125,14 @@ void System::finalize(bool finMPI) noexcept {
 }
 
 void System::oneWriterDistribCache(EvictionStrategy es) {
-  if (MPI_GET_RANK() == 0) {
+  if (rank == 0) {
     // We assume this process is the manager.
     cacheManager().initialize();
     cacheManager().run();
   } else {
     // Here this process is running as a worker.  So perform the
     // worker's lifecycle activities here.
-    CacheWorker *worker = new StorageCacheWorker();
+    CacheWorker *worker = new StorageCacheWorker(workerThreads);
     worker->initialize(); // Initalize
     worker->run();        // This method runs until manager send finish
     worker->finalize();   // Do any clean-ups for this run
@@ -135,6 +143,18 @@ void System::setCacheSize(unsigned long long cSize) noexcept {
   cacheSize = cSize;
 }
 
+void System::setWriteBackLimit(unsigned long long limit) noexcept {
+  writeBackLimit = limit;
+}
+
+void System::setWorkerThreads(unsigned int threads) noexcept {
+  workerThreads = threads;
+}
+
+void System::setProgressThread(bool enable) noexcept {
+  progressThread = enable;
+}
+
 END_NAMESPACE(pc2l);
 // }   // end namespace pc2l
 
@@ -48,55 +48,72 @@ BEGIN_NAMESPACE(pc2l);
 void Worker::send(MessagePtr msgPtr, const int destRank) {
   // Send message only if the pointer is set
   if (msgPtr) {
-    MPI_SEND(msgPtr.get(), msgPtr->getSize(), MPI_TYPE_CHAR, destRank,
-             msgPtr->tag);
+    MPI_Request req = startSend(msgPtr, destRank);
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
   }
 }
-// Recieve a message using our recv buffer
+
+MPI_Request Worker::startSend(const MessagePtr &msgPtr, const int destRank) {
+  MPI_Request req;
+  const int size = msgPtr->getSize();
+  if (destRank == 0) {
+    // The manager receives messages of any size as they come
+    MPI_Isend(msgPtr.get(), size, MPI_CHAR, destRank, msgPtr->tag,
+              MPI_COMM_WORLD, &req);
+  } else if (size <= ControlSlotSize) {
+    MPI_Isend(msgPtr.get(), size, MPI_CHAR, destRank, CONTROL_TAG,
+              MPI_COMM_WORLD, &req);
+  } else {
+    // The header tells the worker how large the message is and where
+    // to find it, so it is sent first on its own
+    MPI_Send(msgPtr.get(), sizeof(Message), MPI_CHAR, destRank, CONTROL_TAG,
+             MPI_COMM_WORLD);
+    MPI_Isend(msgPtr.get(), size, MPI_CHAR, destRank,
+              (size <= BlockSlotSize) ? BLOCK_TAG : LARGE_TAG, MPI_COMM_WORLD,
+              &req);
+  }
+  return req;
+}
+// Recieve a message straight into a buffer owned by the message
 MessagePtr Worker::recv(const int srcRank, const int tag) {
-  // First poll and find out the size of the message to read
+  // First poll and find out the size of the message to read. The
+  // matched probe removes the message from the queue, so no other
+  // receive can take it before it is read below.
   MPI_STATUS status;
-  try {
-    MPI_PROBE(srcRank, tag, status);
-  } catch (CONST_EXP MPI_EXCEPTION &e) {
-    // Rethrow MPI exception as a pc2l::Exception
-    throw PC2L_EXP(e.Get_error_string(), "MPI_PROBE error (can't do much)");
+  MPI_Message handle;
+  if (MPI_Mprobe(srcRank, tag, MPI_COMM_WORLD, &handle, &status) !=
+      MPI_SUCCESS) {
+    throw PC2L_EXP("MPI_Mprobe failed", "MPI_MPROBE error (can't do much)");
   }
 
   // Figure out the size of the size we need.
   const int msgSize = MPI_GET_COUNT(status, MPI_TYPE_CHAR);
-  recvBuf.resize(msgSize);
-  // Read the actual string data.
-  try {
-    MPI_RECV(recvBuf.data(), msgSize, MPI_CHAR, status.MPI_SOURCE,
-             status.MPI_TAG, status);
-  } catch (CONST_EXP MPI_EXCEPTION &e) {
-    // Rethrow MPI exception as a pc2l::Exception
-    throw PC2L_EXP(e.Get_error_string(), "MPI_RECV error (can't do much)");
-  }
-
-  // Return our buffer as if it is a message
-  return Message::create(recvBuf.data());
+  // Read the actual data into the message's own buffer, so that it can
+  // be cached without a copy
+  return Message::createReceived(msgSize, [&handle, msgSize](char *buffer) {
+    if (MPI_Mrecv(buffer, msgSize, MPI_CHAR, &handle, MPI_STATUS_IGNORE) !=
+        MPI_SUCCESS) {
+      throw PC2L_EXP("MPI_Mrecv failed", "MPI_MRECV error (can't do much)");
+    }
+  });
 }
 
-// Recieve a message using our recv buffer
-MPI_Request Worker::startReceiveNonblocking(const int srcRank, const int tag) {
-  // First poll and find out the size of the message to read
-  MPI_STATUS status;
-  // Figure out the size of the size we need.
-  const int msgSize = MPI_GET_COUNT(status, MPI_TYPE_CHAR);
+// Start receiving a message into a caller-supplied buffer. The message
+// can not be probed for its size before it is sent, so the buffer has to
+// be large enough already
+MPI_Request Worker::startReceiveNonblocking(std::vector<char> &buffer,
+                                            const int srcRank, const int tag) {
   MPI_Request req;
-  MPI_Irecv(recvBuf.data(), msgSize, MPI_CHAR, srcRank, status.MPI_TAG,
-            MPI_COMM_WORLD, &req);
+  MPI_Irecv(buffer.data(), static_cast<int>(buffer.size()), MPI_CHAR, srcRank,
+            tag, MPI_COMM_WORLD, &req);
   // Return the request asssociated with this
   return req;
 }
 
 // Waits on a request
-MessagePtr Worker::wait(MPI_Request req) {
-  MPI_Status status;
-  MPI_Wait(&req, &status);
-  return Message::create(recvBuf.data());
+MessagePtr Worker::wait(MPI_Request &req, std::vector<char> &buffer) {
+  MPI_Wait(&req, MPI_STATUS_IGNORE);
+  return Message::create(buffer.data());
 }
 
 void Worker::run() {
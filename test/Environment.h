@@ -30,9 +30,8 @@ public:
   void SetUp() override {
     ::testing::TestEventListeners &listeners =
         ::testing::UnitTest::GetInstance()->listeners();
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    if (rank != 0) {
+    // MPI is left to the library, whose progress thread may be using it
+    if (pc2l::System::get().worldRank() != 0) {
       delete listeners.Release(listeners.default_result_printer());
     }
   }
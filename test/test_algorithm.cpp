@@ -0,0 +1,344 @@
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie                            rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+
+#include "Environment.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <vector>
+
+class AlgorithmTest : public ::testing::Test {};
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  auto &pc2l = pc2l::System::get();
+  pc2l.setCacheSize(3 * (sizeof(pc2l::Message) + 8 * sizeof(int)));
+  pc2l.initialize(argc, argv);
+  pc2l.start();
+  auto rank = pc2l::MPI_GET_RANK();
+
+  auto env = new PC2LEnvironment();
+  ::testing::AddGlobalTestEnvironment(env);
+  auto res = RUN_ALL_TESTS();
+
+  pc2l.stop();
+  pc2l.finalize();
+
+  if (rank == 0) {
+    return res;
+  } else {
+    return 0;
+  }
+}
+
+// Deterministic pseudo-random values so every run sorts the same data
+std::vector<int> randomInts(size_t count, int range) {
+  std::vector<int> values(count);
+  unsigned int seed = 12345;
+  for (auto &v : values) {
+    seed = seed * 1103515245 + 12345;
+    v = static_cast<int>((seed >> 16) % range) - range / 2;
+  }
+  return values;
+}
+
+TEST_F(AlgorithmTest, test_sort) {
+  const auto values = randomInts(1003, 100000);
+  pc2l::Vector<int, 8 * sizeof(int)> intVec;
+  intVec.append(values.data(), values.size());
+  pc2l::sort(intVec);
+  auto expected = values;
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(intVec.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_EQ(intVec.at(i), expected[i]);
+  }
+}
+
+TEST_F(AlgorithmTest, test_sort_duplicates) {
+  // only a handful of distinct values, so buckets are uneven
+  const auto values = randomInts(500, 3);
+  pc2l::Vector<int, 8 * sizeof(int)> intVec;
+  intVec.append(values.data(), values.size());
+  pc2l::sort(intVec);
+  auto expected = values;
+  std::sort(expected.begin(), expected.end());
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_EQ(intVec.at(i), expected[i]);
+  }
+}
+
+TEST_F(AlgorithmTest, test_sort_cached_writes) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // these writes only exist in the manager cache before sorting
+  intVec[99] = -1;
+  intVec[98] = -2;
+  pc2l::sort(intVec);
+  ASSERT_EQ(intVec.at(0), -2);
+  ASSERT_EQ(intVec.at(1), -1);
+  for (int i = 2; i < 100; i++) {
+    ASSERT_EQ(intVec.at(i), i - 2);
+  }
+}
+
+TEST_F(AlgorithmTest, test_sort_small) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec;
+  for (int i = 5; i > 0; i--) {
+    intVec.push_back(i);
+  }
+  pc2l::sort(intVec);
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(intVec.at(i), i + 1);
+  }
+}
+
+TEST_F(AlgorithmTest, test_sort_zero_pages) {
+  // most of the vector is zero pages, which the workers never saw
+  pc2l::Vector<int, 8 * sizeof(int)> intVec(200);
+  for (int i = 0; i < 10; i++) {
+    intVec[i * 20] = 10 - i;
+  }
+  pc2l::sort(intVec);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_EQ(intVec.at(i), (i < 190) ? 0 : i - 189);
+  }
+}
+
+TEST_F(AlgorithmTest, test_for_each_segment) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // a range starting and ending inside a block is split at block edges
+  std::vector<size_t> counts;
+  int expected = 5;
+  pc2l::for_each_segment(intVec.begin() + 5, intVec.begin() + 30,
+                         [&](int *values, size_t count) {
+                           counts.push_back(count);
+                           for (size_t i = 0; i < count; i++) {
+                             ASSERT_EQ(values[i], expected++);
+                           }
+                         });
+  ASSERT_EQ(counts, std::vector<size_t>({3, 8, 8, 6}));
+}
+
+TEST_F(AlgorithmTest, test_segmented_reads) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  ASSERT_EQ(pc2l::accumulate(intVec.begin(), intVec.end(), 0), 4950);
+  ASSERT_EQ(pc2l::find(intVec.begin(), intVec.end(), 57).i, 57);
+  ASSERT_EQ(pc2l::find(intVec.begin(), intVec.end(), 100), intVec.end());
+  ASSERT_EQ(pc2l::count_if(intVec.begin(), intVec.end(),
+                           [](int v) { return v % 2 == 0; }),
+            50);
+  std::vector<int> values(100);
+  pc2l::copy(intVec.begin(), intVec.end(), values.begin());
+  ASSERT_TRUE(pc2l::equal(intVec.begin(), intVec.end(), values.begin()));
+  values[63] = -1;
+  ASSERT_FALSE(pc2l::equal(intVec.begin(), intVec.end(), values.begin()));
+  std::vector<int> squares;
+  pc2l::transform(intVec.begin(), intVec.begin() + 10,
+                  std::back_inserter(squares), [](int v) { return v * v; });
+  ASSERT_EQ(squares[9], 81);
+}
+
+TEST_F(AlgorithmTest, test_segmented_writes) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  pc2l::fill(intVec.begin() + 10, intVec.begin() + 20, -1);
+  pc2l::transform(intVec.begin(), intVec.end(), intVec.begin(),
+                  [](int v) { return v * 2; });
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intVec.at(i), (i >= 10 && i < 20) ? -2 : 2 * i);
+  }
+}
+
+TEST_F(AlgorithmTest, test_for_each) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // writes still in the manager cache are seen by the workers
+  intVec.replace(3, -3);
+  intVec.replace(98, -98);
+  const int offset = 1000;
+  pc2l::for_each(intVec.begin() + 2, intVec.begin() + 99,
+                 pc2l::portable([offset](int &v) { v += offset; }));
+  for (int i = 0; i < 100; i++) {
+    const int value = (i == 3 || i == 98) ? -i : i;
+    ASSERT_EQ(intVec.at(i), (i >= 2 && i < 99) ? value + offset : value);
+  }
+  // state kept by the function is returned when it runs on the manager
+  int sum = 0;
+  pc2l::for_each(intVec.begin(), intVec.begin() + 2,
+                 [&sum](int v) { sum += v; });
+  ASSERT_EQ(sum, 1);
+  // functions that capture by reference are never sent to the workers
+  sum = 0;
+  pc2l::for_each(intVec.begin(), intVec.end(), [&sum](int v) { sum += v; });
+  ASSERT_EQ(sum, 4950 + 97 * offset - 2 * 3 - 2 * 98);
+}
+
+int twice(int v) { return 2 * v; }
+bool isEven(int v) { return v % 2 == 0; }
+
+TEST_F(AlgorithmTest, test_function_pointer) {
+  // function pointers differ between processes, so a range larger than
+  // the cache is still transformed on the manager
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  pc2l::transform(intVec.begin(), intVec.end(), intVec.begin(), twice);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intVec.at(i), 2 * i);
+  }
+  ASSERT_EQ(pc2l::count_if(intVec.begin(), intVec.end(), isEven), 100);
+}
+
+TEST_F(AlgorithmTest, test_transform_to_vector) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  pc2l::Vector<int, 8 * sizeof(int)> out(100);
+  pc2l::transform(intVec.begin(), intVec.end(), out.begin(),
+                  [](int v) { return -v; });
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(out.at(i), -i);
+    ASSERT_EQ(intVec.at(i), i);
+  }
+}
+
+TEST_F(AlgorithmTest, test_reduce) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // writes still in the manager cache are folded in by the manager
+  intVec.replace(7, 1007);
+  intVec.replace(99, -99);
+  ASSERT_EQ(pc2l::reduce(intVec, 0), 4950 + 1000 - 198);
+  ASSERT_EQ(pc2l::reduce(intVec, 5LL, std::plus<long long>()),
+            4950 + 1000 - 198 + 5);
+  ASSERT_EQ(pc2l::reduce(intVec, 500, pc2l::Min()), -99);
+  ASSERT_EQ(pc2l::reduce(intVec, 0, pc2l::Max()), 1007);
+  ASSERT_EQ(pc2l::transform_reduce(intVec, size_t(0), std::plus<>(),
+                                   [](int v) -> size_t { return v % 2 == 0; }),
+            50U);
+  // operations without an MPI builtin are combined along a tree
+  struct MinMax {
+    int min, max;
+  };
+  const MinMax range = pc2l::transform_reduce(
+      intVec, MinMax{0, 0},
+      [](MinMax lhs, MinMax rhs) {
+        return MinMax{std::min(lhs.min, rhs.min), std::max(lhs.max, rhs.max)};
+      },
+      [](int v) { return MinMax{v, v}; });
+  ASSERT_EQ(range.min, -99);
+  ASSERT_EQ(range.max, 1007);
+  // the reduction leaves the vector unchanged
+  ASSERT_EQ(intVec.at(7), 1007);
+  ASSERT_EQ(intVec.at(50), 50);
+}
+
+TEST_F(AlgorithmTest, test_reduce_zero_pages) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  intVec.resize(1000);
+  intVec[500] = 500;
+  intVec.resize(1003);
+  // zero pages are folded in by the manager without being created
+  ASSERT_EQ(pc2l::reduce(intVec, 0), 4950 + 500);
+  ASSERT_EQ(pc2l::transform_reduce(intVec, size_t(0), std::plus<>(),
+                                   [](int v) -> size_t { return v == 0; }),
+            1003U - 100);
+  ASSERT_EQ(pc2l::reduce(intVec, 0, pc2l::Min()), 0);
+  ASSERT_FALSE(intVec.zeroRuns.empty());
+  // results need not be default constructible
+  struct Count {
+    explicit Count(size_t n) : n(n) {}
+    size_t n;
+  };
+  const Count zeros = pc2l::transform_reduce(
+      intVec, Count(0),
+      [](Count lhs, Count rhs) { return Count(lhs.n + rhs.n); },
+      [](int v) { return Count(v == 0); });
+  ASSERT_EQ(zeros.n, 1003U - 100);
+}
+
+TEST_F(AlgorithmTest, test_search) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // writes still in the manager cache are searched by the manager
+  intVec.replace(4, 77);
+  intVec.replace(90, 77);
+  const auto isSeventySeven = [](int v) { return v == 77; };
+  ASSERT_EQ(pc2l::find_if(intVec.begin(), intVec.end(), isSeventySeven).i, 4);
+  ASSERT_EQ(
+      pc2l::find_if(intVec.begin() + 5, intVec.begin() + 95, isSeventySeven).i,
+      77);
+  ASSERT_EQ(pc2l::find(intVec.begin() + 78, intVec.end(), 77).i, 90);
+  ASSERT_EQ(pc2l::find(intVec.begin(), intVec.end(), -1), intVec.end());
+  ASSERT_EQ(pc2l::count_if(intVec.begin(), intVec.end(), isSeventySeven), 3U);
+  ASSERT_EQ(pc2l::count_if(intVec.begin() + 10, intVec.begin() + 95,
+                           [](int v) { return v % 10 == 0; }),
+            8U);
+  ASSERT_EQ(pc2l::find_all(intVec.begin(), intVec.end(), isSeventySeven),
+            std::vector<size_t>({4, 77, 90}));
+  ASSERT_EQ(pc2l::find_all(intVec.begin() + 5, intVec.begin() + 50,
+                           [](int v) { return v % 20 == 0; }),
+            std::vector<size_t>({20, 40}));
+  ASSERT_TRUE(pc2l::find_all(intVec.begin(), intVec.end(), [](int v) {
+                return v < 0;
+              }).empty());
+}
+
+TEST_F(AlgorithmTest, test_search_zero_pages) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  intVec.resize(1000);
+  intVec[500] = -1;
+  // zero pages are searched by the manager without being created
+  const auto isZero = [](int v) { return v == 0; };
+  ASSERT_EQ(pc2l::find_if(intVec.begin() + 1, intVec.end(), isZero).i, 100);
+  ASSERT_EQ(pc2l::count_if(intVec.begin(), intVec.end(), isZero), 900U);
+  ASSERT_EQ(pc2l::find(intVec.begin(), intVec.end(), -1).i, 500);
+  const auto zeros = pc2l::find_all(intVec.begin(), intVec.end(), isZero);
+  ASSERT_EQ(zeros.size(), 900U);
+  ASSERT_EQ(zeros[1], 100U);
+  ASSERT_EQ(zeros[400], 499U);
+  ASSERT_EQ(zeros[401], 501U);
+  ASSERT_TRUE(pc2l::find_all(intVec.begin(), intVec.end(), [](int v) {
+                return v > 99;
+              }).empty());
+  ASSERT_FALSE(intVec.zeroRuns.empty());
+}
+
+// Two kernels for checking that ids are not silently reused
+static void firstKernel(pc2l::CacheWorker &, const pc2l::MessagePtr &) {}
+static void secondKernel(pc2l::CacheWorker &, const pc2l::MessagePtr &) {}
+
+TEST_F(AlgorithmTest, test_kernel_registry) {
+  const size_t id = pc2l::KernelRegistry::add("test_kernel", firstKernel);
+  ASSERT_EQ(pc2l::KernelRegistry::find(id), firstKernel);
+  // registering the same kernel again is fine, but a different one
+  // under the same id is not
+  ASSERT_EQ(pc2l::KernelRegistry::add("test_kernel", firstKernel), id);
+  ASSERT_THROW(pc2l::KernelRegistry::add("test_kernel", secondKernel),
+               pc2l::Exception);
+  ASSERT_EQ(pc2l::KernelRegistry::find(id), firstKernel);
+}
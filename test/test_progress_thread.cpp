@@ -0,0 +1,167 @@
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie                            rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+
+#include "Algorithm.h"
+#include "Environment.h"
+#include "MPIHelper.h"
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+class ProgressThreadTest : public ::testing::Test {};
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  auto &pc2l = pc2l::System::get();
+  pc2l.setCacheSize(3 * (sizeof(pc2l::Message) + 8 * sizeof(int)));
+  // the manager keeps MPI traffic going between library calls
+  pc2l.setProgressThread(true);
+  pc2l.initialize(argc, argv);
+  pc2l.start();
+  auto rank = pc2l.worldRank();
+
+  auto env = new PC2LEnvironment();
+  ::testing::AddGlobalTestEnvironment(env);
+  auto res = RUN_ALL_TESTS();
+
+  pc2l.stop();
+  pc2l.finalize();
+
+  if (rank == 0) {
+    return res;
+  } else {
+    return 0;
+  }
+}
+
+TEST_F(ProgressThreadTest, test_prefetch_and_write_back) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(1000);
+  auto &cm = pc2l::System::get().cacheManager();
+  if (cm.workersRunning()) {
+    // blocks requested ahead arrive while the application is busy
+    for (size_t tag = 50; tag < 54; tag++) {
+      ASSERT_TRUE(cm.prefetchBlock(intVec.dsTag, tag,
+                                   sizeof(pc2l::Message) + 8 * sizeof(int)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(intVec.at(i), i);
+  }
+  for (int pass = 1; pass <= 2; pass++) {
+    for (int i = 0; i < 1000; i += 2) {
+      intVec.replace(i, intVec.at(i) + 1);
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(intVec.at(i), (i % 2 == 0) ? i + 2 : i);
+  }
+}
+
+TEST_F(ProgressThreadTest, test_write_back_while_sleeping) {
+  auto &cm = pc2l::System::get().cacheManager();
+  if (!cm.workersRunning()) {
+    return;
+  }
+  const auto oldLimit = cm.writeBackLimit;
+  cm.writeBackLimit = 64 * 1024 * 1024;
+  // every block evicts the one before it, and the blocks are large
+  // enough to be sent via rendezvous, which only completes once the
+  // manager's MPI is driven again. Filling the vector with one batch
+  // of blocks per worker leaves no block held back.
+  constexpr int BlockInts = 32 * 1024;
+  const int workers = pc2l::MPI_GET_SIZE() - 1;
+  const int blocks = workers * pc2l::CacheManager::StoreBatchSize + 1;
+  pc2l::Vector<int, BlockInts * sizeof(int)> intVec;
+  unsigned long long maxBytes = 0;
+  for (int i = 0; i < blocks * BlockInts; i++) {
+    intVec.push_back(i);
+    maxBytes = std::max(maxBytes, cm.getWriteBackBytes());
+  }
+  ASSERT_GT(maxBytes, 0ULL);
+  // no library calls from here on: only the progress thread can retire
+  // the write-backs still in flight
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (cm.getWriteBackBytes() != 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(cm.getWriteBackBytes(), 0ULL);
+  for (int i = 0; i < blocks * BlockInts; i += BlockInts / 2) {
+    ASSERT_EQ(intVec.at(i), i);
+  }
+  cm.writeBackLimit = oldLimit;
+}
+
+TEST_F(ProgressThreadTest, test_misses_and_appends) {
+  auto &cm = pc2l::System::get().cacheManager();
+  // appended blocks beyond the cache go straight to their owners, and
+  // are then fetched back by demand misses, while the progress thread
+  // drives the write-backs of the blocks evicted in between
+  std::vector<int> values(5000);
+  std::iota(values.begin(), values.end(), 0);
+  pc2l::Vector<int, 8 * sizeof(int)> intVec;
+  for (size_t done = 0; done < values.size(); done += 1000) {
+    intVec.append(values.data() + done, 1000);
+    ASSERT_EQ(intVec.at(done / 2), static_cast<int>(done / 2));
+  }
+  ASSERT_EQ(intVec.size(), values.size());
+  for (size_t i = 0; i < values.size(); i += 7) {
+    intVec.replace(i, -intVec.at(i));
+  }
+  if (cm.workersRunning()) {
+    // misses of several blocks at once, some of them still being sent
+    const auto blocks = cm.getBlocksFallbackRemote(intVec.dsTag, {3, 300, 600});
+    for (const auto &block : blocks) {
+      ASSERT_NE(block, nullptr);
+    }
+  }
+  // read backwards, so that every block is a miss again
+  for (size_t i = values.size(); i-- > 0;) {
+    ASSERT_EQ(intVec.at(i), (i % 7 == 0) ? -values[i] : values[i]);
+  }
+}
+
+TEST_F(ProgressThreadTest, test_kernels_and_updates) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(1000);
+  ASSERT_EQ(intVec.fetch_add(7, 3), 7);
+  pc2l::for_each(intVec.begin(), intVec.end(), [](int &value) { value += 1; });
+  ASSERT_EQ(pc2l::reduce(intVec, 0LL, std::plus<long long>()),
+            499500LL + 3 + 1000);
+  ASSERT_EQ(intVec.at(7), 11);
+}
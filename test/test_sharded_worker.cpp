@@ -0,0 +1,103 @@
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie                            rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+
+#include "Algorithm.h"
+#include "Environment.h"
+#include "MPIHelper.h"
+#include <numeric>
+
+class ShardedWorkerTest : public ::testing::Test {};
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  auto &pc2l = pc2l::System::get();
+  pc2l.setCacheSize(3 * (sizeof(pc2l::Message) + 8 * sizeof(int)));
+  // every worker serves its requests from 4 threads
+  pc2l.setWorkerThreads(4);
+  pc2l.initialize(argc, argv);
+  pc2l.start();
+  auto rank = pc2l::MPI_GET_RANK();
+
+  auto env = new PC2LEnvironment();
+  ::testing::AddGlobalTestEnvironment(env);
+  auto res = RUN_ALL_TESTS();
+
+  pc2l.stop();
+  pc2l.finalize();
+
+  if (rank == 0) {
+    return res;
+  } else {
+    return 0;
+  }
+}
+
+TEST_F(ShardedWorkerTest, test_store_and_get) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(1000);
+  // blocks are written back and fetched again in every pass
+  for (int pass = 1; pass <= 3; pass++) {
+    for (int i = 999; i >= 0; i--) {
+      intVec.replace(i, intVec.at(i) + 1);
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(intVec.at(i), i + 3);
+  }
+  // replies to batched and prefetched requests come back in order
+  auto &cm = pc2l::System::get().cacheManager();
+  if (cm.workersRunning()) {
+    std::vector<size_t> tags(40);
+    std::iota(tags.begin(), tags.end(), 10);
+    const auto blocks = cm.getBlocksFallbackRemote(intVec.dsTag, tags);
+    for (size_t b = 0; b < tags.size(); b++) {
+      ASSERT_NE(blocks[b], nullptr);
+      ASSERT_EQ(reinterpret_cast<const int *>(blocks[b]->getPayload())[0],
+                static_cast<int>(tags[b] * 8 + 3));
+    }
+  }
+}
+
+TEST_F(ShardedWorkerTest, test_updates_and_kernels) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(1000);
+  ASSERT_EQ(intVec.fetch_add(3, 10), 3);
+  ASSERT_EQ(intVec.at(3), 13);
+  pc2l::for_each(intVec.begin(), intVec.end(), [](int &value) { value *= 2; });
+  ASSERT_EQ(pc2l::reduce(intVec, 0LL, std::plus<long long>()),
+            2 * (499500LL + 10));
+  ASSERT_EQ(pc2l::count_if(intVec.begin(), intVec.end(),
+                           [](int value) { return value % 4 == 0; }),
+            500);
+}
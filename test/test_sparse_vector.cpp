@@ -0,0 +1,139 @@
+//---------------------------------------------------------------------
+//  ____
+// |  _ \    This file is part of  PC2L:  A Parallel & Cloud Computing
+// | |_) |   Library <http://www.pc2lab.cec.miamioh.edu/pc2l>. PC2L is
+// |  __/    free software: you can  redistribute it and/or  modify it
+// |_|       under the terms of the GNU  General Public License  (GPL)
+//           as published  by  the   Free  Software Foundation, either
+//           version 3 (GPL v3), or  (at your option) a later version.
+//
+//   ____    PC2L  is distributed in the hope that it will  be useful,
+//  / ___|   but   WITHOUT  ANY  WARRANTY;  without  even  the IMPLIED
+// | |       WARRANTY of  MERCHANTABILITY  or FITNESS FOR A PARTICULAR
+// | |___    PURPOSE.
+//  \____|
+//            Miami University and  the PC2Lab development team make no
+//            representations  or  warranties  about the suitability of
+//  ____      the software,  either  express  or implied, including but
+// |___ \     not limited to the implied warranties of merchantability,
+//   __) |    fitness  for a  particular  purpose, or non-infringement.
+//  / __/     Miami  University and  its affiliates shall not be liable
+// |_____|    for any damages  suffered by the  licensee as a result of
+//            using, modifying,  or distributing  this software  or its
+//            derivatives.
+//
+//  _         By using or  copying  this  Software,  Licensee  agree to
+// | |        abide  by the intellectual  property laws,  and all other
+// | |        applicable  laws of  the U.S.,  and the terms of the  GNU
+// | |___     General  Public  License  (version 3).  You  should  have
+// |_____|    received a  copy of the  GNU General Public License along
+//            with MUSE.  If not,  you may  download  copies  of GPL V3
+//            from <http://www.gnu.org/licenses/>.
+//
+// --------------------------------------------------------------------
+// Authors:   JD Rudie                             rudiejd@miamioh.edu
+//---------------------------------------------------------------------
+
+#include "Environment.h"
+
+class SparseVectorTest : public ::testing::Test {};
+
+using IntSparseVec = pc2l::SparseVector<int, 8 * sizeof(int)>;
+
+int main(int argc, char *argv[]) {
+  auto cacheSize = 3 * (sizeof(pc2l::Message) + 8 * sizeof(int));
+
+  ::testing::InitGoogleTest(&argc, argv);
+  auto &pc2l = pc2l::System::get();
+
+  pc2l.setCacheSize(cacheSize);
+  pc2l.initialize(argc, argv);
+  pc2l.start();
+
+  auto rank = pc2l::MPI_GET_RANK();
+
+  auto env = new PC2LEnvironment();
+  ::testing::AddGlobalTestEnvironment(env);
+
+  auto res = RUN_ALL_TESTS();
+
+  pc2l.stop();
+  pc2l.finalize();
+
+  if (rank == 0) {
+    return res;
+  } else {
+    return 0;
+  }
+}
+
+TEST_F(SparseVectorTest, test_default) {
+  IntSparseVec vec(1ULL << 40, -1);
+  ASSERT_EQ(vec.size(), 1ULL << 40);
+  ASSERT_EQ(vec.at(0), -1);
+  ASSERT_EQ(vec[(1ULL << 40) - 1], -1);
+  // writing the default value does not create a block
+  vec.set(12345, -1);
+  ASSERT_FALSE(vec.hasBlock(12345));
+  ASSERT_EQ(vec.storedBlocks(), 0);
+  ASSERT_THROW(vec.at(1ULL << 40), pc2l::Exception);
+}
+
+TEST_F(SparseVectorTest, test_set) {
+  IntSparseVec vec(1ULL << 40);
+  // far more blocks than fit in the cache, spread over the index space
+  for (size_t i = 0; i < 50; i++) {
+    vec.set(i * 1000003, static_cast<int>(i + 1));
+  }
+  ASSERT_EQ(vec.storedBlocks(), 50);
+  for (size_t i = 0; i < 50; i++) {
+    ASSERT_EQ(vec.at(i * 1000003), static_cast<int>(i + 1));
+    // neighbours in the same block were filled with the default
+    ASSERT_TRUE(vec.hasBlock(i * 1000003 + 1) ||
+                (i * 1000003 + 1) % IntSparseVec::BlockElementCount == 0);
+    ASSERT_EQ(vec.at(i * 1000003 + 1), 0);
+  }
+  vec.set(0, 42);
+  ASSERT_EQ(vec.at(0), 42);
+  ASSERT_EQ(vec.storedBlocks(), 50);
+}
+
+TEST_F(SparseVectorTest, test_for_each_block) {
+  IntSparseVec vec(1000);
+  vec.set(3, 3);
+  vec.set(500, 500);
+  vec.set(999, 999);
+  int sum = 0;
+  size_t blocks = 0;
+  vec.for_each_block([&](size_t first, const int *values, size_t count) {
+    blocks++;
+    for (size_t i = 0; i < count; i++) {
+      ASSERT_TRUE(values[i] == 0 || values[i] == static_cast<int>(first + i));
+      sum += values[i];
+    }
+  });
+  ASSERT_EQ(blocks, 3);
+  ASSERT_EQ(sum, 3 + 500 + 999);
+}
+
+TEST_F(SparseVectorTest, test_block_not_found) {
+  auto &cm = pc2l::System::get().cacheManager();
+  IntSparseVec vec(1000);
+  for (size_t i = 0; i < 10; i++) {
+    vec.set(i * IntSparseVec::BlockElementCount, 1);
+  }
+  ASSERT_TRUE(cm.probeBlock(vec.dsTag, 9));
+  ASSERT_FALSE(cm.probeBlock(vec.dsTag, 50));
+  if (pc2l::MPI_GET_RANK() != 0) {
+    // the workers run the tests without workers of their own
+    return;
+  }
+  // the first blocks were evicted to their workers, so they are probed
+  // remotely, and workers answer for blocks they do not have
+  ASSERT_TRUE(cm.probeBlock(vec.dsTag, 0));
+  ASSERT_EQ(cm.getBlockFallbackRemote(vec.dsTag, 50), nullptr);
+  const auto blocks = cm.getBlocksFallbackRemote(vec.dsTag, {1, 51, 2});
+  ASSERT_NE(blocks[0], nullptr);
+  ASSERT_EQ(blocks[1], nullptr);
+  ASSERT_NE(blocks[2], nullptr);
+}
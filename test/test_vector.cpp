@@ -35,11 +35,26 @@
 //---------------------------------------------------------------------
 
 #include "Environment.h"
+#include "MessagePool.h"
+#include <cstring>
 #include <gtest/gtest.h>
+#include <numeric>
+#include <thread>
 #include <unistd.h>
 
 class VectorTest : public ::testing::Test {};
 
+// An update for Vector::apply that keeps the larger of two values
+struct KeepMax {
+  static void apply(char *value, const char *operand) {
+    int current, candidate;
+    std::memcpy(&current, value, sizeof(int));
+    std::memcpy(&candidate, operand, sizeof(int));
+    current = std::max(current, candidate);
+    std::memcpy(value, &current, sizeof(int));
+  }
+};
+
 int main(int argc, char *argv[]) {
   auto cacheSize = 3 * (sizeof(pc2l::Message) + 8 * sizeof(int));
 
@@ -243,3 +258,505 @@ TEST_F(VectorTest, test_reverse) {
     ASSERT_EQ(99 - i, intVec[i]);
   }
 }
+
+TEST_F(VectorTest, test_read) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // whole vector (13 blocks with a cache of 3 blocks)
+  std::vector<int> all(intVec.size());
+  intVec.read(0, intVec.size(), all.data());
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(all[i], i);
+  }
+  // range that starts and ends in the middle of a block
+  std::vector<int> part(30);
+  intVec.read(37, part.size(), part.data());
+  for (int i = 0; i < 30; i++) {
+    ASSERT_EQ(part[i], 37 + i);
+  }
+  // iterator-range overload
+  std::vector<int> tail;
+  intVec.read(intVec.begin() + 90, intVec.end(), std::back_inserter(tail));
+  ASSERT_EQ(tail.size(), 10);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(tail[i], 90 + i);
+  }
+  ASSERT_THROW(intVec.read(95, 10, part.data()), pc2l::Exception);
+}
+
+TEST_F(VectorTest, test_append) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec;
+  std::vector<int> values(100);
+  std::iota(values.begin(), values.end(), 0);
+  intVec.append(values.data(), values.size());
+  ASSERT_EQ(intVec.size(), 100);
+  // tops up the partially filled tail block
+  intVec.append(values.data(), 5);
+  ASSERT_EQ(intVec.size(), 105);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intVec.at(i), i);
+  }
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(intVec.at(100 + i), i);
+  }
+  intVec.push_back(42);
+  ASSERT_EQ(intVec.at(105), 42);
+}
+
+TEST_F(VectorTest, test_assign) {
+  auto &cm = pc2l::System::get().cacheManager();
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  ASSERT_NE(cm.getBlock(intVec.dsTag, 12, true), nullptr);
+  std::vector<int> values(50, 7);
+  intVec.assign(values.begin(), values.end());
+  ASSERT_EQ(intVec.size(), 50);
+  for (size_t i = 0; i < intVec.size(); i++) {
+    ASSERT_EQ(intVec.at(i), 7);
+  }
+  // the blocks past the new contents are gone
+  ASSERT_EQ(cm.getBlock(intVec.dsTag, 12, true), nullptr);
+  // growing again does not bring back the old values
+  intVec.resize(100);
+  for (size_t i = 50; i < intVec.size(); i++) {
+    ASSERT_EQ(intVec.at(i), 0);
+  }
+}
+
+TEST_F(VectorTest, test_fill_constructor) {
+  pc2l::Vector<int, 8 * sizeof(int)> zeroVec(100);
+  ASSERT_EQ(zeroVec.size(), 100);
+  for (size_t i = 0; i < zeroVec.size(); i++) {
+    ASSERT_EQ(zeroVec.at(i), 0);
+  }
+  pc2l::Vector<int, 8 * sizeof(int)> fiveVec(37, 5);
+  ASSERT_EQ(fiveVec.size(), 37);
+  for (size_t i = 0; i < fiveVec.size(); i++) {
+    ASSERT_EQ(fiveVec.at(i), 5);
+  }
+}
+
+TEST_F(VectorTest, test_insert_range) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // 20 values spanning several blocks inserted into the middle of a block
+  std::vector<int> values(20, -1);
+  intVec.insert(43, values.begin(), values.end());
+  ASSERT_EQ(intVec.size(), 120);
+  for (size_t i = 0; i < 43; i++) {
+    ASSERT_EQ(intVec.at(i), i);
+  }
+  for (size_t i = 43; i < 63; i++) {
+    ASSERT_EQ(intVec.at(i), -1);
+  }
+  for (size_t i = 63; i < intVec.size(); i++) {
+    ASSERT_EQ(intVec.at(i), i - 20);
+  }
+  // iterator overload at the front
+  intVec.insert(intVec.begin(), values.begin(), values.begin() + 3);
+  ASSERT_EQ(intVec.size(), 123);
+  ASSERT_EQ(intVec.at(2), -1);
+  ASSERT_EQ(intVec.at(3), 0);
+  ASSERT_EQ(intVec.at(122), 99);
+}
+
+TEST_F(VectorTest, test_erase_range) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  intVec.erase(5, 30);
+  ASSERT_EQ(intVec.size(), 75);
+  for (size_t i = 0; i < 5; i++) {
+    ASSERT_EQ(intVec.at(i), i);
+  }
+  for (size_t i = 5; i < intVec.size(); i++) {
+    ASSERT_EQ(intVec.at(i), i + 25);
+  }
+  // iterator overload erasing the tail
+  intVec.erase(intVec.begin() + 70, intVec.end());
+  ASSERT_EQ(intVec.size(), 70);
+  ASSERT_EQ(intVec.at(69), 94);
+  ASSERT_THROW(intVec.erase(60, 80), pc2l::Exception);
+}
+
+TEST_F(VectorTest, test_clear) {
+  auto &cm = pc2l::System::get().cacheManager();
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  ASSERT_NE(cm.getBlock(intVec.dsTag, 12, true), nullptr);
+  intVec.clear();
+  ASSERT_EQ(intVec.size(), 0);
+  ASSERT_EQ(cm.getBlock(intVec.dsTag, 12, true), nullptr);
+  // the vector is reusable after being cleared
+  for (int i = 0; i < 20; i++) {
+    intVec.push_back(-i);
+  }
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(intVec.at(i), -i);
+  }
+  if (!cm.workersRunning()) {
+    return;
+  }
+  // blocks dropped behind the back of the vector are reported
+  cm.dropDataStructure(intVec.dsTag);
+  ASSERT_THROW(intVec.at(0), pc2l::Exception);
+  ASSERT_THROW(*intVec.begin(), pc2l::Exception);
+  std::vector<int> values(20);
+  ASSERT_THROW(intVec.read(0, values.size(), values.data()),
+               pc2l::Exception);
+}
+
+TEST_F(VectorTest, test_copy_and_move) {
+  auto &cm = pc2l::System::get().cacheManager();
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  size_t copyTag;
+  {
+    auto copy = intVec;
+    copyTag = copy.dsTag;
+    ASSERT_NE(copyTag, intVec.dsTag);
+    copy[50] = -1;
+    ASSERT_EQ(copy.size(), 100);
+    ASSERT_EQ(copy.at(50), -1);
+    ASSERT_EQ(intVec.at(50), 50);
+    ASSERT_EQ(copy.at(99), 99);
+  }
+  // the copy released its blocks when it went out of scope
+  ASSERT_EQ(cm.getBlock(copyTag, 6, true), nullptr);
+  const auto tag = intVec.dsTag;
+  auto moved = std::move(intVec);
+  ASSERT_EQ(moved.dsTag, tag);
+  ASSERT_EQ(moved.size(), 100);
+  ASSERT_EQ(intVec.size(), 0);
+  for (size_t i = 0; i < moved.size(); i++) {
+    ASSERT_EQ(moved.at(i), i);
+  }
+  // move assignment releases the blocks of the target
+  pc2l::Vector<int, 8 * sizeof(int)> target = createRangeIntVec(10);
+  const auto targetTag = target.dsTag;
+  target = std::move(moved);
+  ASSERT_EQ(target.dsTag, tag);
+  ASSERT_EQ(target.at(99), 99);
+  ASSERT_EQ(cm.getBlock(targetTag, 0, true), nullptr);
+}
+
+TEST_F(VectorTest, test_dirty_blocks) {
+  auto &cm = pc2l::System::get().cacheManager();
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  ASSERT_EQ(intVec.at(0), 0);
+  if (pc2l::MPI_GET_RANK() == 0) {
+    // block 0 was evicted while filling the vector, so it came back
+    // from its worker and has not been written since
+    ASSERT_FALSE(cm.getBlock(intVec.dsTag, 0, true)->dirty);
+  }
+  intVec.replace(1, -1);
+  ASSERT_TRUE(cm.getBlock(intVec.dsTag, 0, true)->dirty);
+  // reading the rest evicts both the written and the clean blocks
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intVec.at(i), (i == 1) ? -1 : i);
+  }
+  ASSERT_EQ(intVec.at(1), -1);
+}
+
+TEST_F(VectorTest, test_reference) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  ASSERT_EQ(intVec[5], 5);
+  // another vector pushes block 0 of intVec out of the cache, so writing
+  // through a reference has to fetch it again rather than write into the
+  // evicted copy
+  pc2l::Vector<int, 8 * sizeof(int)> other = createRangeIntVec(40);
+  intVec[6] = -6;
+  other.append(std::vector<int>(40, 1).data(), 40);
+  ASSERT_EQ(intVec.at(50), 50);
+  ASSERT_EQ(intVec.at(6), -6);
+  // std algorithms write through the iterator's reference
+  std::iota(intVec.begin(), intVec.end(), 1000);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intVec.at(i), 1000 + i);
+  }
+  auto it = intVec.begin() + 10;
+  ASSERT_EQ(it[7], 1017);
+  swap(intVec[0], intVec[99]);
+  ASSERT_EQ(intVec[0], 1099);
+  ASSERT_EQ(intVec[99], 1000);
+  // compound assignments write back like operator=
+  intVec[20] += 5;
+  intVec[21] -= 5;
+  ++intVec[22];
+  ASSERT_EQ(intVec[23]--, 1023);
+  ASSERT_EQ(intVec.at(20), 1025);
+  ASSERT_EQ(intVec.at(21), 1016);
+  ASSERT_EQ(intVec.at(22), 1023);
+  ASSERT_EQ(intVec.at(23), 1022);
+}
+
+TEST_F(VectorTest, test_iterator_cursor) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  // step forwards and backwards across block boundaries
+  auto it = intVec.begin();
+  for (int i = 0; i < 100; i++, ++it) {
+    ASSERT_EQ(*it, i);
+  }
+  for (int i = 99; i >= 0; i--) {
+    --it;
+    ASSERT_EQ(*it, i);
+  }
+  // iterators are ordered by position
+  const auto first = intVec.begin() + 10, second = intVec.begin() + 20;
+  ASSERT_TRUE(first <= second);
+  ASSERT_TRUE(first <= first);
+  ASSERT_FALSE(second <= first);
+  ASSERT_TRUE(second >= first);
+  ASSERT_FALSE(first >= second);
+  // the iterator pins its block, so the block stays cached while another
+  // vector streams through the cache, until the iterator moves on
+  auto &cm = pc2l::System::get().cacheManager();
+  it = intVec.begin() + 3;
+  ASSERT_EQ(*it, 3);
+  pc2l::Vector<int, 8 * sizeof(int)> other = createRangeIntVec(40);
+  other.append(std::vector<int>(40, 1).data(), 40);
+  const auto block = cm.getBlock(intVec.dsTag, 0, true);
+  ASSERT_NE(block, nullptr);
+  ASSERT_EQ(block->pins, 1);
+  *it = -3;
+  ASSERT_EQ(*(it + 1), 4);
+  it += 8;
+  ASSERT_EQ(*it, 11);
+  ASSERT_EQ(block->pins, 0);
+  ASSERT_EQ(intVec.at(3), -3);
+}
+
+TEST_F(VectorTest, test_block_lease) {
+  auto &cm = pc2l::System::get().cacheManager();
+  using IntVec = pc2l::Vector<int, 8 * sizeof(int)>;
+  IntVec intVec = createRangeIntVec(100);
+  {
+    auto lease = intVec.lease(3);
+    const auto &block = lease.get();
+    // the block stays in the cache while the rest of the vector streams
+    // through it, and writes go straight to the only copy
+    for (int i = 8; i < 100; i++) {
+      ASSERT_EQ(intVec.at(i), i);
+    }
+    ASSERT_EQ(cm.getBlock(intVec.dsTag, 0, true), block);
+    lease.values<int>()[3 % IntVec::BlockElementCount] = -3;
+    ASSERT_EQ(intVec.at(3), -3);
+    // pins are counted, but only half of the cache can be pinned
+    auto again = intVec.lease(7);
+    ASSERT_THROW(intVec.lease(50), pc2l::Exception);
+    again.release();
+    ASSERT_EQ(block->pins, 1);
+    ASSERT_GT(cm.getPinnedBytes(), 0);
+  }
+  ASSERT_EQ(cm.getPinnedBytes(), 0);
+  // once the lease is gone the block is evicted (and written back) again
+  for (int i = 99; i >= 0; i--) {
+    ASSERT_EQ(intVec.at(i), (i == 3) ? -3 : i);
+  }
+  ASSERT_THROW(intVec.lease(100), pc2l::Exception);
+  // clearing the vector invalidates the leases that are still held
+  auto stale = intVec.lease(10);
+  ASSERT_GT(cm.getPinnedBytes(), 0);
+  intVec.clear();
+  ASSERT_EQ(stale.get()->pins, 0);
+  ASSERT_EQ(cm.getPinnedBytes(), 0);
+  stale.release();
+  ASSERT_EQ(cm.getPinnedBytes(), 0);
+}
+
+TEST_F(VectorTest, test_prefetch) {
+  // walk down a column of a 20 x 16 row-major matrix, so that every
+  // access skips a block
+  pc2l::Vector<int, 8 * sizeof(int), 2, pc2l::ADAPTIVE> matrix;
+  std::vector<int> values(20 * 16);
+  std::iota(values.begin(), values.end(), 0);
+  matrix.append(values.data(), values.size());
+  for (int row = 0; row < 20; row++) {
+    ASSERT_EQ(matrix.at(row * 16 + 3), row * 16 + 3);
+  }
+  const auto &prefetcher = matrix.getPrefetcher();
+  ASSERT_EQ(prefetcher.getStride(), 16);
+  // the first three rows are needed to learn the stride, and every
+  // prediction after that is used
+  ASSERT_EQ(prefetcher.getMissed(), 3);
+  ASSERT_EQ(prefetcher.getUseful(), 17);
+  ASSERT_DOUBLE_EQ(prefetcher.getAccuracy(), 1.0);
+  ASSERT_DOUBLE_EQ(prefetcher.getCoverage(), 17.0 / 20);
+  // backward walks are picked up as well
+  for (int i = 20 * 16 - 1; i >= 0; i--) {
+    ASSERT_EQ(matrix.at(i), i);
+  }
+  ASSERT_EQ(prefetcher.getStride(), -1);
+  ASSERT_GT(prefetcher.getUseful(), 17 + 30);
+  // writes between prefetches go to the blocks that are read back, and
+  // blocks still in flight are waited for rather than requested again
+  for (int i = 0; i < 20 * 16; i += 5) {
+    matrix[i] = -i;
+  }
+  for (int i = 0; i < 20 * 16; i++) {
+    ASSERT_EQ(matrix.at(i), (i % 5) ? i : -i);
+  }
+}
+
+TEST_F(VectorTest, test_resize) {
+  auto &cm = pc2l::System::get().cacheManager();
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(20);
+  ASSERT_EQ(intVec.capacity(), 24U);
+  // reserving creates no blocks
+  intVec.reserve(1000);
+  ASSERT_EQ(intVec.capacity(), 1000U);
+  ASSERT_EQ(intVec.size(), 20U);
+  ASSERT_EQ(cm.getBlock(intVec.dsTag, 3, true), nullptr);
+  // the erased values are still in the tail of block 1
+  intVec.erase(10, 20);
+  intVec.resize(1000);
+  ASSERT_EQ(intVec.size(), 1000);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(intVec.at(i), (i < 10) ? i : 0);
+  }
+  // reading zero pages does not create them
+  ASSERT_EQ(cm.getBlock(intVec.dsTag, 62, true), nullptr);
+  intVec[500] = 5;
+  ASSERT_NE(cm.getBlock(intVec.dsTag, 62, true), nullptr);
+  ASSERT_EQ(cm.getBlock(intVec.dsTag, 63, true), nullptr);
+  ASSERT_EQ(pc2l::accumulate(intVec.begin(), intVec.end(), 0), 45 + 5);
+  // shrinking and growing again zeroes the values in between
+  intVec.resize(5);
+  ASSERT_EQ(intVec.size(), 5);
+  intVec.resize(20);
+  intVec.push_back(7);
+  for (int i = 0; i < 21; i++) {
+    ASSERT_EQ(intVec.at(i), (i < 5) ? i : (i == 20) ? 7 : 0);
+  }
+  // a zero-filled vector of 64 GiB is made of zero pages only
+  const unsigned long long bigSize = 1ULL << 33;
+  pc2l::Vector<double> big(bigSize);
+  ASSERT_EQ(big.size(), bigSize);
+  ASSERT_EQ(big.at(bigSize - 1), 0.0);
+  big[bigSize / 2] = 1.5;
+  ASSERT_EQ(big.at(bigSize / 2), 1.5);
+  ASSERT_EQ(big.at(bigSize / 2 + 1), 0.0);
+  // a copy shares the zero pages rather than creating them
+  pc2l::Vector<double> bigCopy(big);
+  ASSERT_EQ(bigCopy.size(), bigSize);
+  ASSERT_EQ(bigCopy.at(bigSize / 2), 1.5);
+  ASSERT_EQ(bigCopy.at(bigSize - 1), 0.0);
+  ASSERT_EQ(cm.getBlock(bigCopy.dsTag, 0, true), nullptr);
+}
+
+TEST_F(VectorTest, test_remote_updates) {
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  auto &cm = pc2l::System::get().cacheManager();
+  const bool remote = cm.workersRunning();
+  // block 0 is no longer cached, so the update is applied by its worker
+  ASSERT_EQ(intVec.fetch_add(3, 10), 3);
+  ASSERT_EQ(intVec.fetch_add(3, -4), 13);
+  if (remote) {
+    ASSERT_EQ(cm.getBlock(intVec.dsTag, 0, true), nullptr);
+  }
+  ASSERT_EQ(intVec.at(3), 9);
+  // block 0 is cached now, so its cached copy is updated
+  ASSERT_EQ(intVec.fetch_add(4, 1), 4);
+  ASSERT_EQ(intVec.at(4), 5);
+  int expected = 50;
+  ASSERT_TRUE(intVec.compare_exchange(50, expected, -50));
+  expected = 50;
+  ASSERT_FALSE(intVec.compare_exchange(50, expected, 500));
+  ASSERT_EQ(expected, -50);
+  ASSERT_EQ(intVec.at(50), -50);
+  const size_t keepMax = pc2l::RegisteredUpdate<KeepMax>::id;
+  ASSERT_EQ(intVec.apply(70, keepMax, 60), 70);
+  ASSERT_EQ(intVec.apply(80, keepMax, 90), 80);
+  ASSERT_EQ(intVec.at(70), 70);
+  ASSERT_EQ(intVec.at(80), 90);
+  // updates of zero pages create them
+  intVec.resize(200);
+  ASSERT_EQ(intVec.fetch_add(150, 2), 0);
+  ASSERT_EQ(intVec.at(150), 2);
+  ASSERT_EQ(pc2l::accumulate(intVec.begin(), intVec.end(), 0),
+            4950 + 6 + 1 - 100 + 10 + 2);
+}
+
+TEST_F(VectorTest, test_batched_transfers) {
+  // evicted blocks are held back and written back in batches
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(1000);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(intVec.at(i), i);
+  }
+  auto &cm = pc2l::System::get().cacheManager();
+  if (!cm.workersRunning()) {
+    return;
+  }
+  // the blocks owned by a worker are requested in a single message
+  std::vector<size_t> tags(20);
+  std::iota(tags.begin(), tags.end(), 100);
+  const auto blocks = cm.getBlocksFallbackRemote(intVec.dsTag, tags);
+  for (size_t b = 0; b < tags.size(); b++) {
+    ASSERT_NE(blocks[b], nullptr);
+    const int *values = reinterpret_cast<const int *>(blocks[b]->getPayload());
+    for (int j = 0; j < 8; j++) {
+      ASSERT_EQ(values[j], static_cast<int>(tags[b] * 8 + j));
+    }
+  }
+  // blocks that do not exist are reported as missing
+  const auto missing =
+      cm.getBlocksFallbackRemote(intVec.dsTag, {200, 201, 202, 203, 204, 205});
+  for (const auto &block : missing) {
+    ASSERT_EQ(block, nullptr);
+  }
+}
+
+TEST_F(VectorTest, test_async_write_back) {
+  // evicted blocks are sent without waiting, up to writeBackLimit bytes
+  auto &cm = pc2l::System::get().cacheManager();
+  const auto oldLimit = cm.writeBackLimit;
+  const unsigned long long limit = 4 * (8 * sizeof(int) + sizeof(pc2l::Message));
+  cm.writeBackLimit = limit;
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(1000);
+  ASSERT_LE(cm.getWriteBackBytes(), limit);
+  // blocks are modified while their earlier versions are being sent
+  for (int pass = 1; pass <= 3; pass++) {
+    for (int i = 0; i < 1000; i += 3) {
+      intVec.replace(i, intVec.at(i) + 1);
+      ASSERT_LE(cm.getWriteBackBytes(), limit);
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(intVec.at(i), (i % 3 == 0) ? i + 3 : i);
+  }
+  cm.writeBackLimit = oldLimit;
+}
+
+TEST_F(VectorTest, test_message_pool) {
+  // blocks fetched after the vector has been created reuse the buffers
+  // of the blocks evicted to make room for them
+  pc2l::Vector<int, 8 * sizeof(int)> intVec = createRangeIntVec(100);
+  const auto before = pc2l::MessagePool::getStats();
+  for (int pass = 0; pass < 3; pass++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(intVec.at(i), i);
+    }
+  }
+  const auto after = pc2l::MessagePool::getStats();
+  ASSERT_GT(after.reused, before.reused);
+  ASSERT_EQ(after.allocated, before.allocated);
+  // buffers released by another thread are reused by this one
+  std::vector<pc2l::MessagePtr> msgs;
+  for (int i = 0; i < 40; i++) {
+    msgs.push_back(pc2l::Message::create(3000, pc2l::Message::STORE_BLOCK));
+  }
+  std::thread([&msgs] { msgs.clear(); }).join();
+  const auto released = pc2l::MessagePool::getStats();
+  for (int i = 0; i < 40; i++) {
+    msgs.push_back(pc2l::Message::create(3000, pc2l::Message::STORE_BLOCK));
+  }
+  ASSERT_EQ(pc2l::MessagePool::getStats().allocated, released.allocated);
+}
+
+TEST_F(VectorTest, test_large_messages) {
+  // blocks too large for a worker's control ring arrive in two parts,
+  // the second one through the block ring or, if even larger, on its own
+  pc2l::Vector<int, 1000 * sizeof(int)> midVec;
+  pc2l::Vector<int, 20000 * sizeof(int)> bigVec;
+  for (int i = 0; i < 60000; i++) {
+    midVec.push_back(i);
+    bigVec.push_back(-i);
+  }
+  for (int i = 0; i < 60000; i += 7) {
+    ASSERT_EQ(midVec.at(i), i);
+    ASSERT_EQ(bigVec.at(i), -i);
+  }
+}